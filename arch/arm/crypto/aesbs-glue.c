@@ -0,0 +1,708 @@
+/*
+ * Glue code for the bit sliced NEON implementation of AES in aesbs-core.S
+ *
+ * ECB, CBC & CTR parts based on code (crypto/ecb.c, cbc.c, ctr.c) by:
+ *   Copyright (c) 2006 Herbert Xu <herbert@gondor.apana.org.au>
+ *   (C) Copyright IBM Corp. 2007 - Joy Latten <latten@us.ibm.com>
+ * Async wrappers based on arch/x86/crypto/serpent_sse2_glue.c by:
+ *   Copyright (c) 2011 Jussi Kivilinna <jussi.kivilinna@mbnet.fi>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/hardirq.h>
+#include <linux/types.h>
+#include <linux/crypto.h>
+#include <linux/err.h>
+#include <crypto/algapi.h>
+#include <crypto/aes.h>
+#include <crypto/cryptd.h>
+#include <crypto/xts.h>
+#include <asm/neon.h>
+
+#define AESBS_BLOCKS		8
+#define AESBS_BYTES		(AESBS_BLOCKS * AES_BLOCK_SIZE)
+#define AESBS_ROUND_KEY_SIZE	(8 * AES_BLOCK_SIZE)
+#define AES_BLOCK_MASK		(~(AES_BLOCK_SIZE - 1))
+
+/* Both work on eight blocks, in place or not */
+asmlinkage void aesbs_encrypt8(u8 out[], u8 const in[], u8 const rk[],
+			       int rounds);
+asmlinkage void aesbs_decrypt8(u8 out[], u8 const in[], u8 const rk[],
+			       int rounds);
+
+typedef void (*aesbs_fn_t)(u8 out[], u8 const in[], u8 const rk[], int rounds);
+
+struct aesbs_ctx {
+	u8 rk[(AES_MAX_KEYLENGTH / AES_BLOCK_SIZE) * AESBS_ROUND_KEY_SIZE];
+	int rounds;
+};
+
+/* CBC encryption is sequential: it is left to the generic cipher */
+struct aesbs_cbc_ctx {
+	struct aesbs_ctx key;
+	struct crypto_cipher *enc;
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx key;
+	struct crypto_cipher *tweak;
+};
+
+struct async_aes_ctx {
+	struct cryptd_ablkcipher *cryptd_tfm;
+};
+
+/*
+ * The key schedule, transposed into the bit sliced layout of the state:
+ * each bit of a round key byte becomes a byte of 0x00 or 0xff, in the
+ * plane of that bit.  The S-box circuit leaves out the 0x63 of the affine
+ * transform, which MixColumns and ShiftRows carry through unchanged, so
+ * it is added to all but the first round key instead.
+ */
+static void aesbs_convert_key(struct aesbs_ctx *ctx, const u32 *key_enc)
+{
+	int r, i, j;
+
+	for (r = 0; r <= ctx->rounds; r++) {
+		u8 *rk = ctx->rk + r * AESBS_ROUND_KEY_SIZE;
+
+		for (j = 0; j < AES_BLOCK_SIZE; j++) {
+			u8 b = key_enc[4 * r + j / 4] >> (8 * (j % 4));
+
+			if (r)
+				b ^= 0x63;
+			for (i = 0; i < 8; i++)
+				rk[i * AES_BLOCK_SIZE + j] = (b >> i) & 1 ? 0xff : 0;
+		}
+	}
+}
+
+static int aesbs_expand_key(struct crypto_tfm *tfm, struct aesbs_ctx *ctx,
+			    const u8 *in_key, unsigned int key_len)
+{
+	struct crypto_aes_ctx rk;
+
+	if (crypto_aes_expand_key(&rk, in_key, key_len)) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	ctx->rounds = 6 + key_len / 4;
+	aesbs_convert_key(ctx, rk.key_enc);
+	memset(&rk, 0, sizeof(rk));
+	return 0;
+}
+
+static int aesbs_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			 unsigned int key_len)
+{
+	return aesbs_expand_key(tfm, crypto_tfm_ctx(tfm), in_key, key_len);
+}
+
+static int aesbs_cbc_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	err = aesbs_expand_key(tfm, &ctx->key, in_key, key_len);
+	if (err)
+		return err;
+	return crypto_cipher_setkey(ctx->enc, in_key, key_len);
+}
+
+static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	/* key consists of keys of equal size concatenated, therefore
+	 * the length must be even
+	 */
+	if (key_len % 2) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	/* first half of xts-key is for crypt */
+	err = aesbs_expand_key(tfm, &ctx->key, in_key, key_len / 2);
+	if (err)
+		return err;
+
+	/* second half of xts-key is for tweak */
+	return crypto_cipher_setkey(ctx->tweak, in_key + key_len / 2,
+				    key_len / 2);
+}
+
+/* Partial groups of blocks go through a buffer */
+static void aesbs_ecb_blocks(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     unsigned int nbytes, aesbs_fn_t fn)
+{
+	u8 buf[AESBS_BYTES];
+
+	while (nbytes >= AESBS_BYTES) {
+		fn(dst, src, ctx->rk, ctx->rounds);
+		src += AESBS_BYTES;
+		dst += AESBS_BYTES;
+		nbytes -= AESBS_BYTES;
+	}
+	if (nbytes) {
+		memcpy(buf, src, nbytes);
+		fn(buf, buf, ctx->rk, ctx->rounds);
+		memcpy(dst, buf, nbytes);
+	}
+}
+
+static void aesbs_cbc_decrypt_blocks(struct aesbs_ctx *ctx, u8 *dst,
+				     const u8 *src, unsigned int nbytes,
+				     u8 *iv)
+{
+	u8 buf[AESBS_BYTES];
+	u8 next_iv[AES_BLOCK_SIZE];
+
+	while (nbytes) {
+		unsigned int n = min_t(unsigned int, nbytes, AESBS_BYTES);
+		const u8 *in = src;
+		unsigned int i;
+
+		if (n < AESBS_BYTES) {
+			memcpy(buf, src, n);
+			in = buf;
+		}
+		aesbs_decrypt8(buf, in, ctx->rk, ctx->rounds);
+
+		/* src is intact until dst is written, even in place */
+		memcpy(next_iv, src + n - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+		for (i = AES_BLOCK_SIZE; i < n; i += AES_BLOCK_SIZE)
+			crypto_xor(buf + i, src + i - AES_BLOCK_SIZE,
+				   AES_BLOCK_SIZE);
+		crypto_xor(buf, iv, AES_BLOCK_SIZE);
+		memcpy(dst, buf, n);
+		memcpy(iv, next_iv, AES_BLOCK_SIZE);
+
+		src += n;
+		dst += n;
+		nbytes -= n;
+	}
+}
+
+/* Also handles a final partial block, whose counter is used up too */
+static void aesbs_ctr_blocks(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     unsigned int nbytes, u8 *ctr)
+{
+	u8 buf[AESBS_BYTES];
+
+	while (nbytes) {
+		unsigned int n = min_t(unsigned int, nbytes, AESBS_BYTES);
+		unsigned int i;
+
+		for (i = 0; i < n; i += AES_BLOCK_SIZE) {
+			memcpy(buf + i, ctr, AES_BLOCK_SIZE);
+			crypto_inc(ctr, AES_BLOCK_SIZE);
+		}
+		aesbs_encrypt8(buf, buf, ctx->rk, ctx->rounds);
+		crypto_xor(buf, src, n);
+		memcpy(dst, buf, n);
+
+		src += n;
+		dst += n;
+		nbytes -= n;
+	}
+}
+
+/*
+ * NEON is claimed for one step of the walk at a time, which keeps the
+ * stretches without preemption short and lets the walk itself sleep.
+ */
+static int ecb_crypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		     struct scatterlist *src, unsigned int nbytes,
+		     aesbs_fn_t fn)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		kernel_neon_begin();
+		aesbs_ecb_blocks(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				 nbytes & AES_BLOCK_MASK, fn);
+		kernel_neon_end();
+		err = blkcipher_walk_done(desc, &walk,
+					  nbytes & (AES_BLOCK_SIZE - 1));
+	}
+
+	return err;
+}
+
+static int ecb_encrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		       struct scatterlist *src, unsigned int nbytes)
+{
+	return ecb_crypt(desc, dst, src, nbytes, aesbs_encrypt8);
+}
+
+static int ecb_decrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		       struct scatterlist *src, unsigned int nbytes)
+{
+	return ecb_crypt(desc, dst, src, nbytes, aesbs_decrypt8);
+}
+
+static int cbc_encrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		       struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *src = walk.src.virt.addr;
+		u8 *dst = walk.dst.virt.addr;
+
+		do {
+			crypto_xor(walk.iv, src, AES_BLOCK_SIZE);
+			crypto_cipher_encrypt_one(ctx->enc, dst, walk.iv);
+			memcpy(walk.iv, dst, AES_BLOCK_SIZE);
+
+			src += AES_BLOCK_SIZE;
+			dst += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int cbc_decrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		       struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		kernel_neon_begin();
+		aesbs_cbc_decrypt_blocks(&ctx->key, walk.dst.virt.addr,
+					 walk.src.virt.addr,
+					 nbytes & AES_BLOCK_MASK, walk.iv);
+		kernel_neon_end();
+		err = blkcipher_walk_done(desc, &walk,
+					  nbytes & (AES_BLOCK_SIZE - 1));
+	}
+
+	return err;
+}
+
+static int ctr_crypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		kernel_neon_begin();
+		aesbs_ctr_blocks(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				 nbytes & AES_BLOCK_MASK, walk.iv);
+		kernel_neon_end();
+		err = blkcipher_walk_done(desc, &walk,
+					  nbytes & (AES_BLOCK_SIZE - 1));
+	}
+	if (walk.nbytes) {
+		kernel_neon_begin();
+		aesbs_ctr_blocks(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				 walk.nbytes, walk.iv);
+		kernel_neon_end();
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	return err;
+}
+
+static void xts_encrypt_callback(void *priv, u8 *blks, unsigned int nbytes)
+{
+	kernel_neon_begin();
+	aesbs_ecb_blocks(priv, blks, blks, nbytes, aesbs_encrypt8);
+	kernel_neon_end();
+}
+
+static void xts_decrypt_callback(void *priv, u8 *blks, unsigned int nbytes)
+{
+	kernel_neon_begin();
+	aesbs_ecb_blocks(priv, blks, blks, nbytes, aesbs_decrypt8);
+	kernel_neon_end();
+}
+
+static int xts_crypt_common(struct blkcipher_desc *desc,
+			    struct scatterlist *dst, struct scatterlist *src,
+			    unsigned int nbytes,
+			    void (*fn)(void *, u8 *, unsigned int))
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	be128 buf[AESBS_BLOCKS];
+	struct xts_crypt_req req = {
+		.tbuf = buf,
+		.tbuflen = sizeof(buf),
+
+		.tweak_ctx = ctx->tweak,
+		.tweak_fn = XTS_TWEAK_CAST(crypto_cipher_encrypt_one),
+		.crypt_ctx = &ctx->key,
+		.crypt_fn = fn,
+	};
+
+	return xts_crypt(desc, dst, src, nbytes, &req);
+}
+
+static int xts_encrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		       struct scatterlist *src, unsigned int nbytes)
+{
+	return xts_crypt_common(desc, dst, src, nbytes, xts_encrypt_callback);
+}
+
+static int xts_decrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
+		       struct scatterlist *src, unsigned int nbytes)
+{
+	return xts_crypt_common(desc, dst, src, nbytes, xts_decrypt_callback);
+}
+
+static int aesbs_cbc_init(struct crypto_tfm *tfm)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->enc = crypto_alloc_cipher("aes", 0, 0);
+	return PTR_RET(ctx->enc);
+}
+
+static void aesbs_cbc_exit(struct crypto_tfm *tfm)
+{
+	struct aesbs_cbc_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_cipher(ctx->enc);
+}
+
+static int aesbs_xts_init(struct crypto_tfm *tfm)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->tweak = crypto_alloc_cipher("aes", 0, 0);
+	return PTR_RET(ctx->tweak);
+}
+
+static void aesbs_xts_exit(struct crypto_tfm *tfm)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_cipher(ctx->tweak);
+}
+
+static int ablk_set_key(struct crypto_ablkcipher *tfm, const u8 *key,
+			unsigned int key_len)
+{
+	struct async_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct crypto_ablkcipher *child = &ctx->cryptd_tfm->base;
+	int err;
+
+	crypto_ablkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ablkcipher_set_flags(child, crypto_ablkcipher_get_flags(tfm)
+				    & CRYPTO_TFM_REQ_MASK);
+	err = crypto_ablkcipher_setkey(child, key, key_len);
+	crypto_ablkcipher_set_flags(tfm, crypto_ablkcipher_get_flags(child)
+				    & CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+/* NEON is off limits in interrupt context: defer to cryptd there */
+static int ablk_encrypt(struct ablkcipher_request *req)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct async_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+
+	if (in_interrupt()) {
+		struct ablkcipher_request *cryptd_req =
+			ablkcipher_request_ctx(req);
+
+		memcpy(cryptd_req, req, sizeof(*req));
+		ablkcipher_request_set_tfm(cryptd_req, &ctx->cryptd_tfm->base);
+
+		return crypto_ablkcipher_encrypt(cryptd_req);
+	} else {
+		struct blkcipher_desc desc;
+
+		desc.tfm = cryptd_ablkcipher_child(ctx->cryptd_tfm);
+		desc.info = req->info;
+		desc.flags = 0;
+
+		return crypto_blkcipher_crt(desc.tfm)->encrypt(
+			&desc, req->dst, req->src, req->nbytes);
+	}
+}
+
+static int ablk_decrypt(struct ablkcipher_request *req)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct async_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+
+	if (in_interrupt()) {
+		struct ablkcipher_request *cryptd_req =
+			ablkcipher_request_ctx(req);
+
+		memcpy(cryptd_req, req, sizeof(*req));
+		ablkcipher_request_set_tfm(cryptd_req, &ctx->cryptd_tfm->base);
+
+		return crypto_ablkcipher_decrypt(cryptd_req);
+	} else {
+		struct blkcipher_desc desc;
+
+		desc.tfm = cryptd_ablkcipher_child(ctx->cryptd_tfm);
+		desc.info = req->info;
+		desc.flags = 0;
+
+		return crypto_blkcipher_crt(desc.tfm)->decrypt(
+			&desc, req->dst, req->src, req->nbytes);
+	}
+}
+
+static void ablk_exit(struct crypto_tfm *tfm)
+{
+	struct async_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	cryptd_free_ablkcipher(ctx->cryptd_tfm);
+}
+
+static int ablk_init(struct crypto_tfm *tfm)
+{
+	struct async_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct cryptd_ablkcipher *cryptd_tfm;
+	char drv_name[CRYPTO_MAX_ALG_NAME];
+
+	snprintf(drv_name, sizeof(drv_name), "__driver-%s",
+		 crypto_tfm_alg_driver_name(tfm));
+
+	cryptd_tfm = cryptd_alloc_ablkcipher(drv_name, 0, 0);
+	if (IS_ERR(cryptd_tfm))
+		return PTR_ERR(cryptd_tfm);
+
+	ctx->cryptd_tfm = cryptd_tfm;
+	tfm->crt_ablkcipher.reqsize = sizeof(struct ablkcipher_request) +
+		crypto_ablkcipher_reqsize(&cryptd_tfm->base);
+
+	return 0;
+}
+
+static struct crypto_alg aesbs_algs[8] = { {
+	.cra_name		= "__ecb-aes-neonbs",
+	.cra_driver_name	= "__driver-ecb-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[0].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= ecb_encrypt,
+			.decrypt	= ecb_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "__cbc-aes-neonbs",
+	.cra_driver_name	= "__driver-cbc-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_cbc_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[1].cra_list),
+	.cra_init		= aesbs_cbc_init,
+	.cra_exit		= aesbs_cbc_exit,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_cbc_set_key,
+			.encrypt	= cbc_encrypt,
+			.decrypt	= cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "__ctr-aes-neonbs",
+	.cra_driver_name	= "__driver-ctr-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[2].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= ctr_crypt,
+			.decrypt	= ctr_crypt,
+		},
+	},
+}, {
+	.cra_name		= "__xts-aes-neonbs",
+	.cra_driver_name	= "__driver-xts-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[3].cra_list),
+	.cra_init		= aesbs_xts_init,
+	.cra_exit		= aesbs_xts_exit,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE * 2,
+			.max_keysize	= AES_MAX_KEY_SIZE * 2,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_set_key,
+			.encrypt	= xts_encrypt,
+			.decrypt	= xts_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ecb(aes)",
+	.cra_driver_name	= "ecb-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct async_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[4].cra_list),
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= ablk_encrypt,
+			.decrypt	= ablk_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct async_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[5].cra_list),
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= ablk_encrypt,
+			.decrypt	= ablk_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct async_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[6].cra_list),
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= ablk_encrypt,
+			.decrypt	= ablk_encrypt,
+			.geniv		= "chainiv",
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct async_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[7].cra_list),
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_u = {
+		.ablkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE * 2,
+			.max_keysize	= AES_MAX_KEY_SIZE * 2,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= ablk_set_key,
+			.encrypt	= ablk_encrypt,
+			.decrypt	= ablk_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	if (!cpu_has_neon()) {
+		printk(KERN_INFO "NEON instructions are not detected.\n");
+		return -ENODEV;
+	}
+
+	return crypto_register_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	crypto_unregister_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+module_init(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit sliced AES in CBC/CTR/ECB/XTS modes using NEON");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,26 @@
+/*
+ * arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * NEON instructions may only be used in kernel mode between these two
+ * calls, which preserve the user's NEON/VFP state and disable preemption
+ * in between.  They must not be called from interrupt context, and the
+ * code calling them must not be compiled with NEON enabled itself: the
+ * compiler could use NEON registers outside of the protected region.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
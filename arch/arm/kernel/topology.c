@@ -48,6 +48,17 @@ const struct cpumask *cpu_coregroup_mask(int cpu)
 	return &cpu_topology[cpu].core_sibling;
 }
 
+/*
+ * ARM cores are power gated one by one in cpuidle and can be hotplugged
+ * on their own (on Tegra, all but CPU0 must be down before cpuquiet can
+ * switch to the LP cluster), so let the scheduler pack light tasks
+ * rather than spread them across the cores.
+ */
+int arch_sd_share_power_domain(void)
+{
+	return 0*SD_SHARE_POWERDOMAIN;
+}
+
 /*
  * store_cpu_topology is called at boot when only one cpu is running
  * and with the mutex cpu_hotplug.lock locked, when several cpus have booted,
@@ -34,6 +34,10 @@
 #include <linux/cpuquiet.h>
 #include <linux/pm_qos.h>
 #include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+
+#include <trace/events/nvpower.h>
 
 #include "pm.h"
 #include "cpu-tegra.h"
@@ -51,6 +55,17 @@ static struct workqueue_struct *cpuquiet_wq;
 static struct work_struct cpuquiet_work;
 static struct timer_list updown_timer;
 
+/*
+ * Raising the minimum number of online CPUs (e.g. the input boost) is
+ * handled on an RT kthread rather than on cpuquiet_wq, so that it is
+ * not delayed behind normal priority work.
+ */
+static struct task_struct *cpuquiet_boost_thread;
+static DEFINE_KTHREAD_WORKER(cpuquiet_boost_worker);
+static struct kthread_work cpuquiet_boost_work;
+/* serializes the work and boost paths */
+static DEFINE_MUTEX(tegra_cpq_apply_lock);
+
 static struct kobject *tegra_auto_sysfs_kobject;
 
 static wait_queue_head_t wait_no_lp;
@@ -341,7 +356,9 @@ static void __cpuinit __apply_core_config(void)
 
 	cpumask_andnot(&online, &online, &cpu_online);
 	for_each_cpu(cpu, &online) {
+		trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_CPU_UP_START, cpu);
 		cpu_up(cpu);
+		trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_CPU_UP_DONE, cpu);
 		hp_stats_update(cpu, true);
 	}
 
@@ -353,7 +370,8 @@ static void __cpuinit __apply_core_config(void)
 	wake_up_interruptible(&wait_cpu);
 }
 
-static void __cpuinit tegra_cpuquiet_work_func(struct work_struct *work)
+/* must be called with tegra_cpq_apply_lock held */
+static void __cpuinit __tegra_cpuquiet_apply(void)
 {
 	int new_cluster, current_cluster, action;
 
@@ -392,18 +410,55 @@ static void __cpuinit tegra_cpuquiet_work_func(struct work_struct *work)
 		__apply_core_config();
 
 	if (current_cluster != new_cluster) {
+		trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_CLUSTER_START,
+				     new_cluster);
 		current_cluster = __apply_cluster_config(current_cluster,
 					new_cluster);
+		trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_CLUSTER_DONE,
+				     current_cluster);
 
 		tegra_cpu_set_speed_cap(NULL);
 
-		if (current_cluster == TEGRA_CPQ_LP)
+		if (current_cluster == TEGRA_CPQ_LP) {
 			cpuquiet_device_busy();
-		else
+		} else {
 			cpuquiet_device_free();
-
+			/*
+			 * Bring up the cores that were waiting for the G
+			 * cluster (e.g. a min_cpus boost) in this same pass
+			 * instead of on the next work.
+			 */
+			__apply_core_config();
+		}
 	}
+}
+
+static void __cpuinit tegra_cpuquiet_apply(void)
+{
+	mutex_lock(&tegra_cpq_apply_lock);
+	trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_WORK_START,
+			     pm_qos_request(PM_QOS_MIN_ONLINE_CPUS));
+	__tegra_cpuquiet_apply();
+	trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_WORK_DONE, num_online_cpus());
+	mutex_unlock(&tegra_cpq_apply_lock);
+}
 
+static void __cpuinit tegra_cpuquiet_work_func(struct work_struct *work)
+{
+	tegra_cpuquiet_apply();
+}
+
+static void __cpuinit tegra_cpuquiet_boost_func(struct kthread_work *work)
+{
+	tegra_cpuquiet_apply();
+}
+
+static int tegra_cpuquiet_boost_thread_fn(void *data)
+{
+	/* no hotplug while suspending, same as cpuquiet_wq */
+	set_freezable();
+
+	return kthread_worker_fn(data);
 }
 
 static int min_cpus_notify(struct notifier_block *nb, unsigned long n, void *p)
@@ -418,7 +473,13 @@ static int min_cpus_notify(struct notifier_block *nb, unsigned long n, void *p)
 	if (n > 1)
 		cpq_target_cluster_state = TEGRA_CPQ_G;
 
-	queue_work(cpuquiet_wq, &cpuquiet_work);
+	if (n > num_online_cpus() || (n > 1 && is_lp_cluster())) {
+		trace_nvcpu_cpuquiet(NVPOWER_CPUQUIET_MIN_CPUS, n);
+		queue_kthread_work(&cpuquiet_boost_worker,
+				   &cpuquiet_boost_work);
+	} else {
+		queue_work(cpuquiet_wq, &cpuquiet_work);
+	}
 
 	mutex_unlock(tegra_cpu_lock);
 
@@ -755,6 +816,10 @@ late_initcall(tegra_cpuquiet_debug_init);
 
 int __cpuinit tegra_auto_hotplug_init(struct mutex *cpulock)
 {
+	struct sched_param sparm = {
+		/* same priority as the input boost thread */
+		.sched_priority = MAX_RT_PRIO - 10
+	};
 	int err;
 
 	cpu_clk = clk_get_sys(NULL, "cpu");
@@ -781,6 +846,17 @@ int __cpuinit tegra_auto_hotplug_init(struct mutex *cpulock)
 		return -ENOMEM;
 
 	INIT_WORK(&cpuquiet_work, tegra_cpuquiet_work_func);
+	init_kthread_work(&cpuquiet_boost_work, tegra_cpuquiet_boost_func);
+
+	cpuquiet_boost_thread = kthread_run(tegra_cpuquiet_boost_thread_fn,
+					    &cpuquiet_boost_worker,
+					    "cpuquiet-boost");
+	if (IS_ERR(cpuquiet_boost_thread)) {
+		destroy_workqueue(cpuquiet_wq);
+		return PTR_ERR(cpuquiet_boost_thread);
+	}
+	sched_setscheduler_nocheck(cpuquiet_boost_thread, SCHED_FIFO, &sparm);
+
 	init_timer(&updown_timer);
 	updown_timer.function = updown_handler;
 
@@ -812,6 +888,7 @@ int __cpuinit tegra_auto_hotplug_init(struct mutex *cpulock)
 
 	err = cpuquiet_register_driver(&tegra_cpuquiet_driver);
 	if (err) {
+		kthread_stop(cpuquiet_boost_thread);
 		destroy_workqueue(cpuquiet_wq);
 		return err;
 	}
@@ -819,6 +896,7 @@ int __cpuinit tegra_auto_hotplug_init(struct mutex *cpulock)
 	err = tegra_auto_sysfs();
 	if (err) {
 		cpuquiet_unregister_driver(&tegra_cpuquiet_driver);
+		kthread_stop(cpuquiet_boost_thread);
 		destroy_workqueue(cpuquiet_wq);
 	}
 
@@ -827,6 +905,7 @@ int __cpuinit tegra_auto_hotplug_init(struct mutex *cpulock)
 
 void tegra_auto_hotplug_exit(void)
 {
+	kthread_stop(cpuquiet_boost_thread);
 	destroy_workqueue(cpuquiet_wq);
         cpuquiet_unregister_driver(&tegra_cpuquiet_driver);
 	kobject_put(tegra_auto_sysfs_kobject);
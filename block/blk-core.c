@@ -1251,6 +1251,7 @@ static bool bio_attempt_front_merge(struct request_queue *q,
  * @q: request_queue new bio is being queued at
  * @bio: new bio being queued
  * @request_count: out parameter for number of traversed plugged requests
+ * @request_bytes: out parameter for the size of those requests
  *
  * Determine whether @bio being queued on @q can be merged with a request
  * on %current's plugged list.  Returns %true if merge was successful,
@@ -1264,7 +1265,8 @@ static bool bio_attempt_front_merge(struct request_queue *q,
  * merging parameters without querying the elevator.
  */
 static bool attempt_plug_merge(struct request_queue *q, struct bio *bio,
-			       unsigned int *request_count)
+			       unsigned int *request_count,
+			       unsigned int *request_bytes)
 {
 	struct blk_plug *plug;
 	struct request *rq;
@@ -1274,12 +1276,15 @@ static bool attempt_plug_merge(struct request_queue *q, struct bio *bio,
 	if (!plug)
 		goto out;
 	*request_count = 0;
+	*request_bytes = 0;
 
 	list_for_each_entry_reverse(rq, &plug->list, queuelist) {
 		int el_ret;
 
-		if (rq->q == q)
+		if (rq->q == q) {
 			(*request_count)++;
+			*request_bytes += blk_rq_bytes(rq);
+		}
 
 		if (rq->q != q || !blk_rq_merge_ok(rq, bio))
 			continue;
@@ -1299,6 +1304,16 @@ out:
 	return ret;
 }
 
+/*
+ * How much a plug may hold for @q before it is flushed: the configured
+ * budget, but at least one request of max_sectors so that full sized
+ * requests can always be built up in the plug.
+ */
+static unsigned int blk_plug_budget(struct request_queue *q)
+{
+	return max(q->plug_budget_kb << 10, queue_max_sectors(q) << 9);
+}
+
 void init_request_from_bio(struct request *req, struct bio *bio)
 {
 	req->cmd_type = REQ_TYPE_FS;
@@ -1320,6 +1335,7 @@ void blk_queue_bio(struct request_queue *q, struct bio *bio)
 	int el_ret, rw_flags, where = ELEVATOR_INSERT_SORT;
 	struct request *req;
 	unsigned int request_count = 0;
+	unsigned int request_bytes = 0;
 
 	/*
 	 * low level driver can indicate that it wants pages above a
@@ -1338,7 +1354,7 @@ void blk_queue_bio(struct request_queue *q, struct bio *bio)
 	 * Check if we can merge with the plugged list before grabbing
 	 * any locks.
 	 */
-	if (attempt_plug_merge(q, bio, &request_count))
+	if (attempt_plug_merge(q, bio, &request_count, &request_bytes))
 		return;
 
 	spin_lock_irq(q->queue_lock);
@@ -1417,7 +1433,8 @@ get_rq:
 				if (__rq->q != q)
 					plug->should_sort = 1;
 			}
-			if (request_count >= BLK_MAX_REQUEST_COUNT) {
+			if (request_count >= BLK_MAX_REQUEST_COUNT ||
+			    request_bytes >= blk_plug_budget(q)) {
 				blk_flush_plug_list(plug, false);
 				trace_block_plug(q);
 			}
@@ -1878,6 +1895,52 @@ static void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static void blk_latency_hist_add(struct request *req)
+{
+	struct blk_latency_hist *hist = &req->q->latency_hist;
+	u64 now = sched_clock();
+	u64 usecs;
+	int type, bucket;
+
+	if (req->cmd_type != REQ_TYPE_FS || now < req->start_time_ns)
+		return;
+
+	/*
+	 * blk_insert_flush() strips REQ_FLUSH from the original request and
+	 * issues the cache flush as q->flush_rq, so count that one as the
+	 * flush.  Other steps of a flush sequence are seen again when the
+	 * original request finally completes.
+	 */
+	if ((req->cmd_flags & REQ_FLUSH_SEQ) && req != &req->q->flush_rq)
+		return;
+
+	if (req->cmd_flags & (REQ_FLUSH | REQ_FUA))
+		type = BLK_LAT_FLUSH;
+	else if (rq_data_dir(req) == READ)
+		type = BLK_LAT_READ;
+	else if (rq_is_sync(req))
+		type = BLK_LAT_SYNC;
+	else
+		type = BLK_LAT_WRITE;
+
+	usecs = div_u64(now - req->start_time_ns, NSEC_PER_USEC);
+	bucket = min_t(int, fls64(usecs), BLK_LAT_HIST_BUCKETS - 1);
+	hist->lat[type][bucket]++;
+}
+
+static void blk_depth_hist_add(struct request_queue *q)
+{
+	int bucket = min_t(int, fls(queue_in_flight(q)),
+			   BLK_DEPTH_HIST_BUCKETS - 1);
+
+	q->latency_hist.depth[bucket]++;
+}
+#else
+static inline void blk_latency_hist_add(struct request *req) {}
+static inline void blk_depth_hist_add(struct request_queue *q) {}
+#endif
+
 static void blk_account_io_done(struct request *req)
 {
 	/*
@@ -2021,6 +2084,7 @@ void blk_dequeue_request(struct request *rq)
 	if (blk_account_rq(rq)) {
 		q->in_flight[rq_is_sync(rq)]++;
 		set_io_start_time_ns(rq);
+		blk_depth_hist_add(q);
 	}
 }
 
@@ -2310,6 +2374,7 @@ static void blk_finish_request(struct request *req, int error)
 		blk_unprep_request(req);
 
 
+	blk_latency_hist_add(req);
 	blk_account_io_done(req);
 
 	if (req->end_io)
@@ -176,6 +176,7 @@ void blk_queue_make_request(struct request_queue *q, make_request_fn *mfn)
 	 * set defaults
 	 */
 	q->nr_requests = BLKDEV_MAX_RQ;
+	q->plug_budget_kb = BLK_PLUG_DEFAULT_BUDGET_KB;
 
 	q->make_request_fn = mfn;
 	blk_queue_dma_alignment(q, 511);
@@ -100,6 +100,26 @@ queue_ra_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+static ssize_t queue_plug_budget_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->plug_budget_kb, (page));
+}
+
+static ssize_t
+queue_plug_budget_store(struct request_queue *q, const char *page, size_t count)
+{
+	unsigned long budget_kb;
+	ssize_t ret = queue_var_store(&budget_kb, page, count);
+
+	/* Keep the byte count within an unsigned int */
+	if (budget_kb > (UINT_MAX >> 10))
+		return -EINVAL;
+
+	q->plug_budget_kb = budget_kb;
+
+	return ret;
+}
+
 static ssize_t queue_max_sectors_show(struct request_queue *q, char *page)
 {
 	int max_sectors_kb = queue_max_sectors(q) >> 1;
@@ -275,6 +295,80 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static ssize_t queue_latency_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_latency_hist *hist = &q->latency_hist;
+	ssize_t ret;
+	int i;
+
+	ret = sprintf(page, "%10s %10s %10s %10s %10s\n",
+		      "usecs<", "read", "write", "sync", "flush");
+	for (i = 0; i < BLK_LAT_HIST_BUCKETS; i++) {
+		if (i < BLK_LAT_HIST_BUCKETS - 1)
+			ret += sprintf(page + ret, "%10lu", 1UL << i);
+		else
+			ret += sprintf(page + ret, "%10s", "inf");
+		ret += sprintf(page + ret, " %10lu %10lu %10lu %10lu\n",
+			       hist->lat[BLK_LAT_READ][i],
+			       hist->lat[BLK_LAT_WRITE][i],
+			       hist->lat[BLK_LAT_SYNC][i],
+			       hist->lat[BLK_LAT_FLUSH][i]);
+	}
+	return ret;
+}
+
+static ssize_t
+queue_latency_hist_store(struct request_queue *q, const char *page,
+			 size_t count)
+{
+	unsigned long val;
+	ssize_t ret = queue_var_store(&val, page, count);
+
+	if (val)
+		return -EINVAL;
+
+	spin_lock_irq(q->queue_lock);
+	memset(q->latency_hist.lat, 0, sizeof(q->latency_hist.lat));
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+static ssize_t queue_depth_hist_show(struct request_queue *q, char *page)
+{
+	unsigned long *depth = q->latency_hist.depth;
+	ssize_t ret;
+	int i;
+
+	ret = sprintf(page, "%10s %10s\n", "depth<", "requests");
+	for (i = 0; i < BLK_DEPTH_HIST_BUCKETS; i++) {
+		if (i < BLK_DEPTH_HIST_BUCKETS - 1)
+			ret += sprintf(page + ret, "%10lu", 1UL << i);
+		else
+			ret += sprintf(page + ret, "%10s", "inf");
+		ret += sprintf(page + ret, " %10lu\n", depth[i]);
+	}
+	return ret;
+}
+
+static ssize_t
+queue_depth_hist_store(struct request_queue *q, const char *page, size_t count)
+{
+	unsigned long val;
+	ssize_t ret = queue_var_store(&val, page, count);
+
+	if (val)
+		return -EINVAL;
+
+	spin_lock_irq(q->queue_lock);
+	memset(q->latency_hist.depth, 0, sizeof(q->latency_hist.depth));
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -287,6 +381,12 @@ static struct queue_sysfs_entry queue_ra_entry = {
 	.store = queue_ra_store,
 };
 
+static struct queue_sysfs_entry queue_plug_budget_entry = {
+	.attr = {.name = "plug_budget_kb", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_plug_budget_show,
+	.store = queue_plug_budget_store,
+};
+
 static struct queue_sysfs_entry queue_max_sectors_entry = {
 	.attr = {.name = "max_sectors_kb", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_max_sectors_show,
@@ -389,9 +489,24 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_latency_hist_show,
+	.store = queue_latency_hist_store,
+};
+
+static struct queue_sysfs_entry queue_depth_hist_entry = {
+	.attr = {.name = "queue_depth_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_depth_hist_show,
+	.store = queue_depth_hist_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
+	&queue_plug_budget_entry.attr,
 	&queue_max_hw_sectors_entry.attr,
 	&queue_max_sectors_entry.attr,
 	&queue_max_segments_entry.attr,
@@ -411,6 +526,10 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_LATENCY_HIST
+	&queue_latency_hist_entry.attr,
+	&queue_depth_hist_entry.attr,
+#endif
 	NULL,
 };
 
@@ -4,7 +4,8 @@
  *
  * Copyright (C) 2012 Brandon Berhent <bbedward@gmail.com>
  *
- * FCFS, dispatches are back-inserted, deadlines ensure fairness.
+ * FCFS for sync and async requests, sync preferred, dispatches are
+ * back-inserted, deadlines and starvation limits ensure fairness.
  * Should work best with devices where there is no travel delay.
  */
 #include <linux/blkdev.h>
@@ -16,9 +17,18 @@
 
 enum zen_data_dir { ASYNC, SYNC };
 
+/*
+ * Requests are queued FCFS on two fifos: one for reads and sync writes
+ * (fsync, O_DIRECT), which someone is waiting on, and one for async
+ * writes.  There is no sorting since the storage this targets has no seek
+ * penalty.  Sync requests are preferred, but a batch of async writes is
+ * issued once sync requests have been chosen writes_starved times in a
+ * row or the oldest async write has expired.
+ */
 static const int sync_expire  = HZ / 2;    /* max time before a sync is submitted. */
 static const int async_expire = 5 * HZ;    /* ditto for async, these limits are SOFT! */
-static const int fifo_batch = 16;
+static const int writes_starved = 2;       /* max times sync requests can starve a write */
+static const int fifo_batch = 16;          /* # of requests issued per direction */
 
 struct zen_data {
 	/* Runtime Data */
@@ -26,10 +36,13 @@ struct zen_data {
 	struct list_head fifo_list[2];
 
 	unsigned int batching;		/* number of sequential requests made */
+	unsigned int starved;		/* times sync requests starved writes */
+	int batch_dir;			/* SYNC or ASYNC, for the current batch */
 
 	/* tunables */
 	int fifo_expire[2];
 	int fifo_batch;
+	int writes_starved;
 };
 
 static inline struct zen_data *
@@ -37,8 +50,6 @@ zen_get_data(struct request_queue *q) {
 	return q->elevator->elevator_data;
 }
 
-static void zen_dispatch(struct zen_data *, struct request *);
-
 static void
 zen_merged_requests(struct request_queue *q, struct request *req,
                     struct request *next)
@@ -63,10 +74,8 @@ static void zen_add_request(struct request_queue *q, struct request *rq)
 	struct zen_data *zdata = zen_get_data(q);
 	const int sync = rq_is_sync(rq);
 
-	if (zdata->fifo_expire[sync]) {
-		rq_set_fifo_time(rq, jiffies + zdata->fifo_expire[sync]);
-		list_add_tail(&rq->queuelist, &zdata->fifo_list[sync]);
-	}
+	rq_set_fifo_time(rq, jiffies + zdata->fifo_expire[sync]);
+	list_add_tail(&rq->queuelist, &zdata->fifo_list[sync]);
 }
 
 static void zen_dispatch(struct zen_data *zdata, struct request *rq)
@@ -80,78 +89,61 @@ static void zen_dispatch(struct zen_data *zdata, struct request *rq)
 }
 
 /*
- * get the first expired request in direction ddir
- */
-static struct request *
-zen_expired_request(struct zen_data *zdata, int ddir)
-{
-        struct request *rq;
-
-        if (list_empty(&zdata->fifo_list[ddir]))
-                return NULL;
-
-        rq = rq_entry_fifo(zdata->fifo_list[ddir].next);
-        if (time_after_eq(jiffies, rq_fifo_time(rq)))
-                return rq;
-
-        return NULL;
-}
-
-/*
- * zen_check_fifo returns 0 if there are no expired requests on the fifo,
- * otherwise it returns the next expired request
+ * zen_fifo_expired returns 1 if the oldest request in direction ddir
+ * has passed its deadline
  */
-static struct request *
-zen_check_fifo(struct zen_data *zdata)
+static inline int
+zen_fifo_expired(struct zen_data *zdata, int ddir)
 {
-        struct request *rq_sync = zen_expired_request(zdata, SYNC);
-        struct request *rq_async = zen_expired_request(zdata, ASYNC);
-
-        if (rq_async && rq_sync) {
-        	if (time_after(rq_fifo_time(rq_async), rq_fifo_time(rq_sync)))
-                	return rq_sync;
-        } else if (rq_sync) {
-                return rq_sync;
-	} else if (rq_async) {
-		return rq_async;
-	}
+	struct request *rq;
 
-        return 0;
-}
+	if (list_empty(&zdata->fifo_list[ddir]))
+		return 0;
 
-static struct request *
-zen_choose_request(struct zen_data *zdata)
-{
-        /*
-         * Retrieve request from available fifo list.
-         * Synchronous requests have priority over asynchronous.
-         */
-        if (!list_empty(&zdata->fifo_list[SYNC]))
-                return rq_entry_fifo(zdata->fifo_list[SYNC].next);
-        if (!list_empty(&zdata->fifo_list[ASYNC]))
-                return rq_entry_fifo(zdata->fifo_list[ASYNC].next);
-
-        return NULL;
+	rq = rq_entry_fifo(zdata->fifo_list[ddir].next);
+	return time_after_eq(jiffies, rq_fifo_time(rq));
 }
 
 static int zen_dispatch_requests(struct request_queue *q, int force)
 {
 	struct zen_data *zdata = zen_get_data(q);
-	struct request *rq = NULL;
+	const int sync = !list_empty(&zdata->fifo_list[SYNC]);
+	const int async = !list_empty(&zdata->fifo_list[ASYNC]);
+	int data_dir = zdata->batch_dir;
 
-	/* Check for and issue expired requests */
-	if (zdata->batching > zdata->fifo_batch) {
-		zdata->batching = 0;
-		rq = zen_check_fifo(zdata);
+	/*
+	 * Keep going in the current direction until the batch is used up,
+	 * unless the other direction has a request past its deadline.
+	 */
+	if (zdata->batching < zdata->fifo_batch &&
+	    !list_empty(&zdata->fifo_list[data_dir]) &&
+	    !zen_fifo_expired(zdata, !data_dir))
+		goto dispatch_request;
+
+	/* Start a new batch, preferring sync requests over async writes */
+	if (sync) {
+		if (async && (zen_fifo_expired(zdata, ASYNC) ||
+			      zdata->starved++ >= zdata->writes_starved))
+			goto dispatch_writes;
+
+		data_dir = SYNC;
+		goto new_batch;
 	}
 
-	if (!rq) {
-		rq = zen_choose_request(zdata);
-		if (!rq)
-			return 0;
+	if (async) {
+dispatch_writes:
+		zdata->starved = 0;
+		data_dir = ASYNC;
+		goto new_batch;
 	}
 
-	zen_dispatch(zdata, rq);
+	return 0;
+
+new_batch:
+	zdata->batch_dir = data_dir;
+	zdata->batching = 0;
+dispatch_request:
+	zen_dispatch(zdata, rq_entry_fifo(zdata->fifo_list[data_dir].next));
 
 	return 1;
 }
@@ -160,7 +152,7 @@ static void *zen_init_queue(struct request_queue *q)
 {
 	struct zen_data *zdata;
 
-	zdata = kmalloc_node(sizeof(*zdata), GFP_KERNEL, q->node);
+	zdata = kmalloc_node(sizeof(*zdata), GFP_KERNEL | __GFP_ZERO, q->node);
 	if (!zdata)
 		return NULL;
 	INIT_LIST_HEAD(&zdata->fifo_list[SYNC]);
@@ -168,6 +160,8 @@ static void *zen_init_queue(struct request_queue *q)
 	zdata->fifo_expire[SYNC] = sync_expire;
 	zdata->fifo_expire[ASYNC] = async_expire;
 	zdata->fifo_batch = fifo_batch;
+	zdata->writes_starved = writes_starved;
+	zdata->batch_dir = SYNC;
 	return zdata;
 }
 
@@ -201,10 +195,11 @@ static ssize_t __FUNC(struct elevator_queue *e, char *page) \
 	int __data = __VAR; \
 	if (__CONV) \
 		__data = jiffies_to_msecs(__data); \
-		return zen_var_show(__data, (page)); \
+	return zen_var_show(__data, (page)); \
 }
 SHOW_FUNCTION(zen_sync_expire_show, zdata->fifo_expire[SYNC], 1);
 SHOW_FUNCTION(zen_async_expire_show, zdata->fifo_expire[ASYNC], 1);
+SHOW_FUNCTION(zen_writes_starved_show, zdata->writes_starved, 0);
 SHOW_FUNCTION(zen_fifo_batch_show, zdata->fifo_batch, 0);
 #undef SHOW_FUNCTION
 
@@ -226,7 +221,8 @@ static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)
 }
 STORE_FUNCTION(zen_sync_expire_store, &zdata->fifo_expire[SYNC], 0, INT_MAX, 1);
 STORE_FUNCTION(zen_async_expire_store, &zdata->fifo_expire[ASYNC], 0, INT_MAX, 1);
-STORE_FUNCTION(zen_fifo_batch_store, &zdata->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(zen_writes_starved_store, &zdata->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(zen_fifo_batch_store, &zdata->fifo_batch, 1, INT_MAX, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -236,6 +232,7 @@ STORE_FUNCTION(zen_fifo_batch_store, &zdata->fifo_batch, 0, INT_MAX, 0);
 static struct elv_fs_entry zen_attrs[] = {
         DD_ATTR(sync_expire),
         DD_ATTR(async_expire),
+        DD_ATTR(writes_starved),
         DD_ATTR(fifo_batch),
         __ATTR_NULL
 };
@@ -272,4 +269,4 @@ module_exit(zen_exit);
 MODULE_AUTHOR("Brandon Berhent");
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Zen IO scheduler");
-MODULE_VERSION("1.1");
+MODULE_VERSION("1.2");
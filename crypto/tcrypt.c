@@ -1571,6 +1571,34 @@ static int do_test(int m)
 				   speed_template_32_64);
 		break;
 
+	case 504:
+		/* by driver name, to compare with mode 200 on any setup */
+		test_acipher_speed("ecb-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32);
+		test_acipher_speed("ecb-aes-neonbs", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32);
+		test_acipher_speed("cbc-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32);
+		test_acipher_speed("cbc-aes-neonbs", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32);
+		test_acipher_speed("ctr-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32);
+		test_acipher_speed("ctr-aes-neonbs", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32);
+		test_acipher_speed("xts-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				   speed_template_32_48_64);
+		test_acipher_speed("xts-aes-neonbs", DECRYPT, sec, NULL, 0,
+				   speed_template_32_48_64);
+		break;
+
+	case 505:
+		/* by driver name, to compare with modes 303 to 306 */
+		test_hash_speed("sha1-asm", sec, generic_hash_speed_template);
+		test_hash_speed("sha256-asm", sec, generic_hash_speed_template);
+		test_hash_speed("sha384-neon", sec, generic_hash_speed_template);
+		test_hash_speed("sha512-neon", sec, generic_hash_speed_template);
+		break;
+
 	case 1000:
 		test_available();
 		break;
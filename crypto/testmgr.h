@@ -502,7 +502,7 @@ static struct hash_testvec sha1_tv_template[] = {
 /*
  * SHA224 test vectors from from FIPS PUB 180-2
  */
-#define SHA224_TEST_VECTORS     2
+#define SHA224_TEST_VECTORS     3
 
 static struct hash_testvec sha224_tv_template[] = {
 	{
@@ -522,13 +522,42 @@ static struct hash_testvec sha224_tv_template[] = {
 			  "\x52\x52\x25\x25",
 		.np     = 2,
 		.tap    = { 28, 28 }
+	}, {
+		.plaintext = "\xec\x29\x56\x12\x44\xed\xe7\x06"
+			     "\xb6\xeb\x30\xa1\xc3\x71\xd7\x44"
+			     "\x50\xa1\x05\xc3\xf9\x73\x5f\x7f"
+			     "\xa9\xfe\x38\xcf\x67\xf3\x04\xa5"
+			     "\x73\x6a\x10\x6e\x92\xe1\x71\x39"
+			     "\xa6\x81\x3b\x1c\x81\xa4\xf3\xd3"
+			     "\xfb\x95\x46\xab\x42\x96\xfa\x9f"
+			     "\x72\x28\x26\xc0\x66\x86\x9e\xda"
+			     "\xcd\x73\xb2\x54\x80\x35\x18\x58"
+			     "\x13\xe2\x26\x34\xa9\xda\x44\x00"
+			     "\x0d\x95\xa2\x81\xff\x9f\x26\x4e"
+			     "\xcc\xe0\xa9\x31\x22\x21\x62\xd0"
+			     "\x21\xcc\xa2\x8d\xb5\xf3\xc2\xaa"
+			     "\x24\x94\x5a\xb1\xe3\x1c\xb4\x13"
+			     "\xae\x29\x81\x0f\xd7\x94\xca\xd5"
+			     "\xdf\xaf\x29\xec\x43\xcb\x38\xd1"
+			     "\x98\xfe\x4a\xe1\xda\x23\x59\x78"
+			     "\x02\x21\x40\x5b\xd6\x71\x2a\x53"
+			     "\x05\xda\x4b\x1b\x73\x7f\xce\x7c"
+			     "\xd2\x1c\x0e\xb7\x72\x8d\x08\x23"
+			     "\x5a\x90\x11",
+		.psize	= 163,
+		.digest	= "\xee\xcf\x8e\x74\x25\xfd\xf1\x6a"
+			  "\xdd\xca\x78\x7e\x45\xe3\x8d\x31"
+			  "\x40\xd8\xfb\xfe\x9a\x15\xfd\x1d"
+			  "\x44\xe7\xad\xf7",
+		.np	= 4,
+		.tap	= { 63, 64, 31, 5 }
 	}
 };
 
 /*
  * SHA256 test vectors from from NIST
  */
-#define SHA256_TEST_VECTORS	2
+#define SHA256_TEST_VECTORS	3
 
 static struct hash_testvec sha256_tv_template[] = {
 	{
@@ -547,13 +576,42 @@ static struct hash_testvec sha256_tv_template[] = {
 			  "\xf6\xec\xed\xd4\x19\xdb\x06\xc1",
 		.np	= 2,
 		.tap	= { 28, 28 }
+	}, {
+		.plaintext = "\xec\x29\x56\x12\x44\xed\xe7\x06"
+			     "\xb6\xeb\x30\xa1\xc3\x71\xd7\x44"
+			     "\x50\xa1\x05\xc3\xf9\x73\x5f\x7f"
+			     "\xa9\xfe\x38\xcf\x67\xf3\x04\xa5"
+			     "\x73\x6a\x10\x6e\x92\xe1\x71\x39"
+			     "\xa6\x81\x3b\x1c\x81\xa4\xf3\xd3"
+			     "\xfb\x95\x46\xab\x42\x96\xfa\x9f"
+			     "\x72\x28\x26\xc0\x66\x86\x9e\xda"
+			     "\xcd\x73\xb2\x54\x80\x35\x18\x58"
+			     "\x13\xe2\x26\x34\xa9\xda\x44\x00"
+			     "\x0d\x95\xa2\x81\xff\x9f\x26\x4e"
+			     "\xcc\xe0\xa9\x31\x22\x21\x62\xd0"
+			     "\x21\xcc\xa2\x8d\xb5\xf3\xc2\xaa"
+			     "\x24\x94\x5a\xb1\xe3\x1c\xb4\x13"
+			     "\xae\x29\x81\x0f\xd7\x94\xca\xd5"
+			     "\xdf\xaf\x29\xec\x43\xcb\x38\xd1"
+			     "\x98\xfe\x4a\xe1\xda\x23\x59\x78"
+			     "\x02\x21\x40\x5b\xd6\x71\x2a\x53"
+			     "\x05\xda\x4b\x1b\x73\x7f\xce\x7c"
+			     "\xd2\x1c\x0e\xb7\x72\x8d\x08\x23"
+			     "\x5a\x90\x11",
+		.psize	= 163,
+		.digest	= "\xd1\xee\x7e\x76\x68\x10\x0c\x9c"
+			  "\x32\xa2\xd3\x92\xb5\x6f\x93\xc6"
+			  "\x77\x42\xe0\x79\x56\xca\x48\xc1"
+			  "\xda\x5b\x84\x0e\x79\xf2\x0e\x42",
+		.np	= 4,
+		.tap	= { 63, 64, 31, 5 }
 	},
 };
 
 /*
  * SHA384 test vectors from from NIST and kerneli
  */
-#define SHA384_TEST_VECTORS	4
+#define SHA384_TEST_VECTORS	5
 
 static struct hash_testvec sha384_tv_template[] = {
 	{
@@ -596,13 +654,63 @@ static struct hash_testvec sha384_tv_template[] = {
 			  "\xc9\x38\xe2\xd1\x99\xe8\xbe\xa4",
 		.np	= 4,
 		.tap	= { 26, 26, 26, 26 }
+	}, {
+		.plaintext = "\x31\xf2\xba\x63\xa8\x05\x9e\xa7"
+			     "\xf2\x36\x8d\xd4\x6a\xff\x96\x54"
+			     "\xd0\x9b\xba\x95\x00\x68\xdb\x0f"
+			     "\x10\xd6\x58\xb8\xc2\x67\xb5\x4a"
+			     "\xd4\xfc\x39\x83\x47\xd9\xa5\xe1"
+			     "\x4b\xd2\xb3\x1b\xe8\xed\x80\x4e"
+			     "\x43\xe3\x23\x4c\xf0\xf6\x02\x43"
+			     "\x1f\x38\xaa\x02\x4a\x06\x11\x3c"
+			     "\xd1\x38\x0a\x7a\xb5\x7f\xd0\x72"
+			     "\x9b\x8d\x48\x0c\xa1\xcf\x22\xcc"
+			     "\x19\x3f\x96\x0c\x41\x00\x89\xdd"
+			     "\x2e\x11\xe0\x8e\xed\x1c\x73\x40"
+			     "\xcc\x44\xce\x5e\x5f\xc4\xe6\x60"
+			     "\x7e\xcb\x52\xf2\x04\xdb\x5e\xd5"
+			     "\x5e\xb5\x69\xb1\xe8\x75\x94\xac"
+			     "\xe6\xf6\x2d\x62\x20\x1d\x9d\x42"
+			     "\xb9\x68\x42\x08\x5e\x50\x67\xd0"
+			     "\xb2\x4b\x0c\xef\x7e\x16\x0a\xfc"
+			     "\x1d\x32\x57\x0c\xfa\x04\x5d\x19"
+			     "\x10\x1b\x63\x8d\xbe\x16\xf4\x93"
+			     "\x83\xed\xf6\x45\xfe\xca\x98\xfd"
+			     "\x89\x70\x78\xb1\x0a\x2f\x0b\x7b"
+			     "\x20\x2b\xa6\xc2\x1c\x71\x35\xa0"
+			     "\x8c\x16\x2c\x81\xee\xc9\xeb\xac"
+			     "\xca\x28\x80\xfa\x9f\xe0\xbd\x1b"
+			     "\xff\x62\xbf\x11\x0e\x5f\xa4\xdc"
+			     "\xc0\x66\xa8\x1b\xd8\x63\x11\x76"
+			     "\x41\x7b\xaa\x92\xc0\x31\x10\x6b"
+			     "\x60\xc9\x6c\xf9\xe1\xd1\xc4\x35"
+			     "\x90\xd2\xd0\xb2\x86\xba\x59\x10"
+			     "\x42\x66\x96\xf0\xce\xbf\x49\x8e"
+			     "\x64\xa7\x4e\x7a\xf4\x8a\xf2\x63"
+			     "\x87\x01\x52\xe6\xbc\x3c\x26\x65"
+			     "\xac\x5f\x64\x10\xd5\x7d\x95\x48"
+			     "\xb4\x46\xf9\x45\x89\xb2\x49\x3a"
+			     "\x6e\x37\x67\x12\xf6\x81\xf8\xaa"
+			     "\x31\x02\xe8\x32\x6e\x40\xbd\x91"
+			     "\x9f\xaf\x2b\x6a\x8d\xa7\x3e\xb1"
+			     "\xf0\x18\xdf\xa7\x99\xed\x12\xce"
+			     "\xf2\xca\x6f\x6e\xa6\xa2\xa7\x37",
+		.psize	= 320,
+		.digest	= "\x39\xa3\xb6\x96\x28\x44\xe5\xc1"
+			  "\xde\x58\x67\xe3\xde\xaf\x24\x2a"
+			  "\x45\x2f\x38\x42\x90\x69\x82\x6c"
+			  "\x18\x7f\x60\xcb\xff\xd7\xc9\x4e"
+			  "\xb7\x2e\xf6\x3c\xa1\xf5\xd1\x06"
+			  "\x1e\x90\xb4\xac\x6d\xf2\x32\x66",
+		.np	= 3,
+		.tap	= { 129, 127, 64 }
 	},
 };
 
 /*
  * SHA512 test vectors from from NIST and kerneli
  */
-#define SHA512_TEST_VECTORS	4
+#define SHA512_TEST_VECTORS	5
 
 static struct hash_testvec sha512_tv_template[] = {
 	{
@@ -653,6 +761,58 @@ static struct hash_testvec sha512_tv_template[] = {
 			  "\xed\xb4\x19\x87\x23\x28\x50\xc9",
 		.np	= 4,
 		.tap	= { 26, 26, 26, 26 }
+	}, {
+		.plaintext = "\x31\xf2\xba\x63\xa8\x05\x9e\xa7"
+			     "\xf2\x36\x8d\xd4\x6a\xff\x96\x54"
+			     "\xd0\x9b\xba\x95\x00\x68\xdb\x0f"
+			     "\x10\xd6\x58\xb8\xc2\x67\xb5\x4a"
+			     "\xd4\xfc\x39\x83\x47\xd9\xa5\xe1"
+			     "\x4b\xd2\xb3\x1b\xe8\xed\x80\x4e"
+			     "\x43\xe3\x23\x4c\xf0\xf6\x02\x43"
+			     "\x1f\x38\xaa\x02\x4a\x06\x11\x3c"
+			     "\xd1\x38\x0a\x7a\xb5\x7f\xd0\x72"
+			     "\x9b\x8d\x48\x0c\xa1\xcf\x22\xcc"
+			     "\x19\x3f\x96\x0c\x41\x00\x89\xdd"
+			     "\x2e\x11\xe0\x8e\xed\x1c\x73\x40"
+			     "\xcc\x44\xce\x5e\x5f\xc4\xe6\x60"
+			     "\x7e\xcb\x52\xf2\x04\xdb\x5e\xd5"
+			     "\x5e\xb5\x69\xb1\xe8\x75\x94\xac"
+			     "\xe6\xf6\x2d\x62\x20\x1d\x9d\x42"
+			     "\xb9\x68\x42\x08\x5e\x50\x67\xd0"
+			     "\xb2\x4b\x0c\xef\x7e\x16\x0a\xfc"
+			     "\x1d\x32\x57\x0c\xfa\x04\x5d\x19"
+			     "\x10\x1b\x63\x8d\xbe\x16\xf4\x93"
+			     "\x83\xed\xf6\x45\xfe\xca\x98\xfd"
+			     "\x89\x70\x78\xb1\x0a\x2f\x0b\x7b"
+			     "\x20\x2b\xa6\xc2\x1c\x71\x35\xa0"
+			     "\x8c\x16\x2c\x81\xee\xc9\xeb\xac"
+			     "\xca\x28\x80\xfa\x9f\xe0\xbd\x1b"
+			     "\xff\x62\xbf\x11\x0e\x5f\xa4\xdc"
+			     "\xc0\x66\xa8\x1b\xd8\x63\x11\x76"
+			     "\x41\x7b\xaa\x92\xc0\x31\x10\x6b"
+			     "\x60\xc9\x6c\xf9\xe1\xd1\xc4\x35"
+			     "\x90\xd2\xd0\xb2\x86\xba\x59\x10"
+			     "\x42\x66\x96\xf0\xce\xbf\x49\x8e"
+			     "\x64\xa7\x4e\x7a\xf4\x8a\xf2\x63"
+			     "\x87\x01\x52\xe6\xbc\x3c\x26\x65"
+			     "\xac\x5f\x64\x10\xd5\x7d\x95\x48"
+			     "\xb4\x46\xf9\x45\x89\xb2\x49\x3a"
+			     "\x6e\x37\x67\x12\xf6\x81\xf8\xaa"
+			     "\x31\x02\xe8\x32\x6e\x40\xbd\x91"
+			     "\x9f\xaf\x2b\x6a\x8d\xa7\x3e\xb1"
+			     "\xf0\x18\xdf\xa7\x99\xed\x12\xce"
+			     "\xf2\xca\x6f\x6e\xa6\xa2\xa7\x37",
+		.psize	= 320,
+		.digest	= "\x63\x5e\xaa\xed\xff\xcd\x63\xda"
+			  "\x52\x20\xed\x86\x16\x31\x76\x0f"
+			  "\x99\x6b\xc5\x00\x92\x64\x09\x7f"
+			  "\x8e\xd7\xbb\x24\x2b\x9b\x1d\x19"
+			  "\x1a\xdb\x0c\x0d\x0c\x62\x69\xdd"
+			  "\x3f\x44\xe8\xea\xd2\x68\x5f\x84"
+			  "\x40\x5b\x61\x6f\x19\xbd\x56\xa4"
+			  "\xc3\xa6\x79\x72\xc6\x62\x25\x46",
+		.np	= 3,
+		.tap	= { 129, 127, 64 }
 	},
 };
 
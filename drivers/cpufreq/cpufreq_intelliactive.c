@@ -54,6 +54,13 @@ struct cpufreq_interactive_cpuinfo {
 	int governor_enabled;
 	int prev_load;
 	unsigned int two_phase_freq;
+	struct sched_load_hook load_hook;
+	unsigned int last_nr_running;
+	bool load_changed;
+	u64 last_eval_time;
+	int last_load;
+	bool settled;
+	bool idle;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -123,6 +130,24 @@ static int timer_slack_val = DEFAULT_TIMER_SLACK;
 
 static bool io_is_busy = 1;
 
+/*
+ * Take load updates from the scheduler instead of sampling on per-CPU
+ * timers.  A busy CPU is re-evaluated from the tick once its run queue
+ * length has changed, or after timer_rate; an idle CPU is not woken,
+ * its vote is dropped instead.
+ */
+static bool sched_load_updates;
+
+/*
+ * Minimum change in load, in percent, for a scheduler-driven evaluation
+ * to choose a new speed when the last one left the speed unchanged.
+ */
+#define DEFAULT_SCHED_LOAD_DELTA 5
+static unsigned int sched_load_delta = DEFAULT_SCHED_LOAD_DELTA;
+
+/* Shortest load window of a scheduler-driven evaluation */
+#define MIN_SCHED_EVAL_TIME (4 * USEC_PER_MSEC)
+
 /*
  * If the max load among other CPUs is higher than up_threshold_any_cpu_load
  * and if the highest frequency among the other CPUs is higher than
@@ -196,6 +221,11 @@ static void cpufreq_interactive_timer_resched(
 				     &pcpu->time_in_idle_timestamp);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
+
+	/* With scheduler load updates the tick drives the next evaluation */
+	if (sched_load_updates)
+		goto out;
+
 	expires = jiffies + usecs_to_jiffies(timer_rate);
 	mod_timer_pinned(&pcpu->cpu_timer, expires);
 
@@ -204,6 +234,7 @@ static void cpufreq_interactive_timer_resched(
 		mod_timer_pinned(&pcpu->cpu_slack_timer, expires);
 	}
 
+out:
 	spin_unlock_irqrestore(&pcpu->load_lock, flags);
 }
 
@@ -217,8 +248,14 @@ static void cpufreq_interactive_timer_start(int cpu)
 	unsigned long expires = jiffies + usecs_to_jiffies(timer_rate);
 	unsigned long flags;
 
-	pcpu->cpu_timer.expires = expires;
-	if (cpu_online(cpu)) {
+	pcpu->idle = false;
+	pcpu->settled = false;
+	if (sched_load_updates) {
+		pcpu->load_changed = false;
+		pcpu->last_eval_time = 0;
+		sched_set_load_hook(cpu, &pcpu->load_hook);
+	} else if (cpu_online(cpu)) {
+		pcpu->cpu_timer.expires = expires;
 		add_timer_on(&pcpu->cpu_timer, cpu);
 		if (timer_slack_val >= 0 && pcpu->target_freq >
 		     pcpu->policy->min) {
@@ -431,6 +468,17 @@ static void cpufreq_interactive_timer(unsigned long data)
 	pcpu->prev_load = cpu_load;
 	boosted = boost_val || now < boostpulse_endtime;
 
+	/*
+	 * Nothing to do if the load hasn't moved since an evaluation that
+	 * kept the current speed.
+	 */
+	if (sched_load_updates && pcpu->settled && !boosted &&
+	    abs(cpu_load - pcpu->last_load) < sched_load_delta)
+		goto rearm;
+
+	pcpu->last_load = cpu_load;
+	pcpu->settled = false;
+
 	if (counter < 5) {
 		counter++;
 		if (counter > 2) {
@@ -532,6 +580,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	}
 
 	if (pcpu->target_freq == new_freq) {
+		pcpu->settled = true;
 		goto rearm_if_notmax;
 	}
 
@@ -546,7 +595,7 @@ rearm_if_notmax:
 	 * Already set max speed and don't see a need to change that,
 	 * wait until next idle to re-evaluate, don't need timer.
 	 */
-	if (pcpu->target_freq == pcpu->policy->max)
+	if (pcpu->target_freq == pcpu->policy->max && !sched_load_updates)
 		goto exit;
 
 rearm:
@@ -558,11 +607,49 @@ exit:
 	return;
 }
 
+/*
+ * Scheduler load hook.  Enqueues only note that the run queue length
+ * changed; the evaluation itself runs from the next tick, outside the
+ * runqueue lock, where the speedchange task can be woken.
+ */
+static void cpufreq_interactive_sched_load(struct sched_load_hook *hook,
+		int cpu, unsigned int nr_running, u64 time, int event)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		container_of(hook, struct cpufreq_interactive_cpuinfo,
+			     load_hook);
+	u64 since_eval;
+
+	/* A remote enqueue is seen by that CPU's next tick */
+	if (cpu != smp_processor_id())
+		return;
+
+	if (nr_running != pcpu->last_nr_running) {
+		pcpu->last_nr_running = nr_running;
+		pcpu->load_changed = true;
+	}
+
+	if (event != SCHED_LOAD_TICK)
+		return;
+
+	since_eval = time - pcpu->last_eval_time;
+	if (since_eval < MIN_SCHED_EVAL_TIME * NSEC_PER_USEC)
+		return;
+	if (!pcpu->load_changed &&
+	    since_eval < (u64)timer_rate * NSEC_PER_USEC)
+		return;
+
+	pcpu->load_changed = false;
+	pcpu->last_eval_time = time;
+	cpufreq_interactive_timer(cpu);
+}
+
 static void cpufreq_interactive_idle_start(void)
 {
 	int cpu = smp_processor_id();
 	struct cpufreq_interactive_cpuinfo *pcpu =
 		&per_cpu(cpuinfo, smp_processor_id());
+	unsigned long flags;
 	int pending;
 	u64 now;
 
@@ -578,6 +665,22 @@ static void cpufreq_interactive_idle_start(void)
 		goto exit;
 	}
 
+	if (sched_load_updates) {
+		/*
+		 * Don't wake up later just to lower the speed.  Have the
+		 * speedchange task drop this CPU's vote the next time it
+		 * runs instead.
+		 */
+		pcpu->idle = true;
+		if (pcpu->target_freq != pcpu->policy->min) {
+			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+			cpumask_set_cpu(cpu, &speedchange_cpumask);
+			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+					       flags);
+		}
+		goto exit;
+	}
+
 	pending = timer_pending(&pcpu->cpu_timer);
 
 	if (pcpu->target_freq != pcpu->policy->min) {
@@ -609,6 +712,7 @@ static void cpufreq_interactive_idle_end(void)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu =
 		&per_cpu(cpuinfo, smp_processor_id());
+	unsigned long flags;
 
 	if (!down_read_trylock(&pcpu->enable_sem))
 		return;
@@ -617,6 +721,20 @@ static void cpufreq_interactive_idle_end(void)
 		return;
 	}
 
+	if (sched_load_updates) {
+		/*
+		 * Leave the load window alone: it has to cover the idle
+		 * period that just ended, or the next tick evaluation would
+		 * see the CPU as fully busy.  Only fold that period in.
+		 */
+		pcpu->idle = false;
+		spin_lock_irqsave(&pcpu->load_lock, flags);
+		update_load(smp_processor_id());
+		spin_unlock_irqrestore(&pcpu->load_lock, flags);
+		up_read(&pcpu->enable_sem);
+		return;
+	}
+
 	/* Arm the timer for 1-2 ticks later if not already. */
 	if (!timer_pending(&pcpu->cpu_timer)) {
 		cpufreq_interactive_timer_resched(pcpu);
@@ -672,10 +790,16 @@ static int cpufreq_interactive_speedchange_task(void *data)
 				struct cpufreq_interactive_cpuinfo *pjcpu =
 					&per_cpu(cpuinfo, j);
 
+				if (pjcpu->idle)
+					continue;
+
 				if (pjcpu->target_freq > max_freq)
 					max_freq = pjcpu->target_freq;
 			}
 
+			if (!max_freq)
+				max_freq = pcpu->policy->min;
+
 			if (max_freq != pcpu->policy->cur)
 				__cpufreq_driver_target(pcpu->policy,
 							max_freq,
@@ -1166,6 +1290,74 @@ static ssize_t store_io_is_busy(struct kobject *kobj,
 static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
 		show_io_is_busy, store_io_is_busy);
 
+static ssize_t show_sched_load_updates(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sched_load_updates);
+}
+
+static ssize_t store_sched_load_updates(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+	unsigned int j;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (sched_load_updates == !!val)
+		return count;
+
+	/* A removed hook may still be running until synchronize_sched() */
+	if (!val) {
+		for_each_possible_cpu(j)
+			sched_set_load_hook(j, NULL);
+		synchronize_sched();
+	}
+
+	sched_load_updates = val;
+	for_each_possible_cpu(j) {
+		pcpu = &per_cpu(cpuinfo, j);
+		down_write(&pcpu->enable_sem);
+		if (pcpu->governor_enabled) {
+			del_timer_sync(&pcpu->cpu_timer);
+			del_timer_sync(&pcpu->cpu_slack_timer);
+			cpufreq_interactive_timer_start(j);
+		}
+		up_write(&pcpu->enable_sem);
+	}
+	return count;
+}
+
+static struct global_attr sched_load_updates_attr =
+	__ATTR(sched_load_updates, 0644,
+		show_sched_load_updates, store_sched_load_updates);
+
+static ssize_t show_sched_load_delta(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sched_load_delta);
+}
+
+static ssize_t store_sched_load_delta(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	sched_load_delta = val;
+	return count;
+}
+
+static struct global_attr sched_load_delta_attr =
+	__ATTR(sched_load_delta, 0644,
+		show_sched_load_delta, store_sched_load_delta);
+
 static ssize_t show_sync_freq(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
@@ -1248,6 +1440,8 @@ static struct attribute *interactive_attributes[] = {
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
 	&io_is_busy_attr.attr,
+	&sched_load_updates_attr.attr,
+	&sched_load_delta_attr.attr,
 	&sampling_down_factor_attr.attr,
 	&sync_freq_attr.attr,
 	&up_threshold_any_cpu_load_attr.attr,
@@ -1422,6 +1616,10 @@ static int cpufreq_governor_intelliactive(struct cpufreq_policy *policy,
 
 	case CPUFREQ_GOV_STOP:
 		mutex_lock(&gov_lock);
+		for_each_cpu(j, policy->cpus)
+			sched_set_load_hook(j, NULL);
+		synchronize_sched();
+
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
 			down_write(&pcpu->enable_sem);
@@ -1504,6 +1702,7 @@ static int __init cpufreq_intelliactive_init(void)
 		pcpu->cpu_timer.data = i;
 		init_timer(&pcpu->cpu_slack_timer);
 		pcpu->cpu_slack_timer.function = cpufreq_interactive_nop_timer;
+		pcpu->load_hook.func = cpufreq_interactive_sched_load;
 		spin_lock_init(&pcpu->load_lock);
 		init_rwsem(&pcpu->enable_sem);
 	}
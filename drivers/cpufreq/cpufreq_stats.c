@@ -20,6 +20,8 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
@@ -169,6 +171,145 @@ static int freq_table_get_index(struct cpufreq_stats *stat, unsigned int freq)
 	return index - 1; /* below lowest freq in table: return -1 */
 }
 
+#ifdef CONFIG_CPU_FREQ_STAT_TASKS
+/*
+ * Per-task time in state.  Every frequency of every CPU gets a slot in
+ * task_stats_freqs[], in the order the tables were first seen; slots are
+ * never reused, so a task's time_in_state[] stays valid as CPUs come and
+ * go.  The CPU time of a task is charged to the current slot of its CPU
+ * when it is switched out and at each tick.
+ */
+static unsigned int task_stats_freqs[CPUFREQ_TASK_STATES_MAX];
+static unsigned int task_stats_num;
+static DEFINE_PER_CPU(int, task_stats_index) = -1;
+
+/* must be called with cpufreq_stats_lock held */
+static int task_stats_get_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < task_stats_num; i++)
+		if (task_stats_freqs[i] == freq)
+			return i;
+	return -1;
+}
+
+/* must be called with cpufreq_stats_lock held */
+static void task_stats_set_index(struct cpufreq_stats *stat)
+{
+	int index = -1;
+
+	if (stat->last_index < stat->state_num)
+		index = task_stats_get_index(
+				stat->freq_table[stat->last_index]);
+	per_cpu(task_stats_index, stat->cpu) = index;
+}
+
+/* must be called with cpufreq_stats_lock held */
+static void task_stats_add_freqs(struct cpufreq_stats *stat)
+{
+	int i;
+
+	for (i = 0; i < stat->state_num; i++) {
+		if (task_stats_get_index(stat->freq_table[i]) >= 0)
+			continue;
+		if (task_stats_num == CPUFREQ_TASK_STATES_MAX)
+			break;
+		task_stats_freqs[task_stats_num] = stat->freq_table[i];
+		/* publish the frequency before the slot */
+		smp_wmb();
+		task_stats_num++;
+	}
+	task_stats_set_index(stat);
+}
+
+const unsigned int *cpufreq_task_stats_freqs(unsigned int *num)
+{
+	*num = ACCESS_ONCE(task_stats_num);
+	smp_rmb();
+	return task_stats_freqs;
+}
+
+void cpufreq_task_stats_init(struct task_struct *p)
+{
+	unsigned int num;
+
+	cpufreq_task_stats_freqs(&num);
+	p->cpufreq_runtime = 0;
+	p->time_in_state = NULL;
+	if (num)
+		p->time_in_state = kcalloc(num, sizeof(u64), GFP_KERNEL);
+	p->max_state = p->time_in_state ? num : 0;
+}
+
+void cpufreq_task_stats_free(struct task_struct *p)
+{
+	kfree(p->time_in_state);
+	p->time_in_state = NULL;
+	p->max_state = 0;
+}
+
+/*
+ * Charge the CPU time @p used since the last call to the current
+ * frequency of this CPU.  Called from the scheduler with the runqueue
+ * locked, on context switch and on every tick, so a frequency change in
+ * the middle of a long time slice is attributed within a tick.
+ */
+void cpufreq_task_stats_update(struct task_struct *p)
+{
+	int index = __this_cpu_read(task_stats_index);
+	u64 runtime = p->se.sum_exec_runtime;
+	u64 delta = runtime - p->cpufreq_runtime;
+
+	p->cpufreq_runtime = runtime;
+	if (index >= 0 && index < p->max_state)
+		p->time_in_state[index] += delta;
+}
+
+/* Add the time in state of @p to @times, in nanoseconds */
+void cpufreq_task_stats_add(struct task_struct *p, u64 *times)
+{
+	int i;
+
+	for (i = 0; i < p->max_state; i++)
+		times[i] += p->time_in_state[i];
+}
+
+/*
+ * /proc/<pid>/time_in_state, summed over the live threads if @whole,
+ * in the same format and units as the cpufreq sysfs time_in_state.
+ */
+int cpufreq_task_stats_show(struct seq_file *m, struct task_struct *p,
+			    int whole)
+{
+	u64 times[CPUFREQ_TASK_STATES_MAX] = { 0 };
+	const unsigned int *freqs;
+	unsigned int num;
+	struct task_struct *t = p;
+	unsigned long flags;
+	int i;
+
+	freqs = cpufreq_task_stats_freqs(&num);
+
+	if (whole && lock_task_sighand(p, &flags)) {
+		do {
+			cpufreq_task_stats_add(t, times);
+		} while_each_thread(p, t);
+		unlock_task_sighand(p, &flags);
+	} else {
+		cpufreq_task_stats_add(p, times);
+	}
+
+	for (i = 0; i < num; i++)
+		seq_printf(m, "%u %llu\n", freqs[i],
+			   (unsigned long long)nsec_to_clock_t(times[i]));
+	return 0;
+}
+#else
+static inline void task_stats_set_index(struct cpufreq_stats *stat) { }
+static inline void task_stats_add_freqs(struct cpufreq_stats *stat) { }
+#endif
+
 /* should be called late in the CPU removal sequence so that the stats
  * memory is still available in case someone tries to use it.
  */
@@ -269,6 +410,7 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
+	task_stats_add_freqs(stat);
 	spin_unlock(&cpufreq_stats_lock);
 	cpufreq_cpu_put(data);
 	return 0;
@@ -326,6 +468,7 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	}
 
 	stat->last_index = new_index;
+	task_stats_set_index(stat);
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	if (old_index >= 0 && new_index >= 0)
 		stat->trans_table[old_index * stat->max_state + new_index]++;
@@ -102,6 +102,43 @@ int cpuidle_play_dead(void)
 	return -ENODEV;
 }
 
+/**
+ * cpuidle_account_prediction - checks the governor's choice of state
+ * @dev: the CPU
+ * @index: the state entered
+ *
+ * Counts the idle periods where a shallower state would have done, as
+ * the residency ended before the target residency of the state entered,
+ * and those where the next deeper state would have paid off.
+ */
+static void cpuidle_account_prediction(struct cpuidle_device *dev, int index)
+{
+	struct cpuidle_state *s = &dev->states[index];
+	int residency = dev->last_residency;
+	int i;
+
+	if (!(s->flags & CPUIDLE_FLAG_TIME_VALID))
+		return;
+
+	if (residency < (int)s->target_residency) {
+		for (i = index - 1; i >= 0; i--) {
+			if (dev->states[i].disabled)
+				continue;
+			dev->states_usage[index].too_deep++;
+			break;
+		}
+	} else {
+		for (i = index + 1; i < dev->state_count; i++) {
+			if (dev->states[i].disabled)
+				continue;
+			if (residency - (int)s->exit_latency >=
+			    (int)dev->states[i].target_residency)
+				dev->states_usage[index].too_shallow++;
+			break;
+		}
+	}
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -158,6 +195,7 @@ int cpuidle_idle_call(void)
 		dev->states_usage[entered_state].time +=
 				(unsigned long long)dev->last_residency;
 		dev->states_usage[entered_state].usage++;
+		cpuidle_account_prediction(dev, entered_state);
 	} else {
 		dev->last_residency = 0;
 	}
@@ -0,0 +1,252 @@
+/*
+ * predict.c - the residency prediction idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/module.h>
+
+#define INTERVALS	8
+#define PULSE		1024
+#define DECAY_SHIFT	3
+
+/*
+ * The next timer event is the only wakeup known in advance, so it is the
+ * starting point: the deepest state whose target residency fits before
+ * it.  Other wakeups (interrupts, IPIs) are not known in advance, so the
+ * governor learns how often they cut idle periods short, separately for
+ * each CPU:
+ *
+ * Every state i gives a bin of idle durations, from its target residency
+ * up to that of the next deeper state.  After each idle period, one of
+ * three decaying counters is bumped:
+ *
+ *  - hits[i]: the timer fell in bin i, and so did the wakeup;
+ *  - misses[i]: the timer fell in bin i, but the CPU woke in a shallower
+ *    bin;
+ *  - intercepts[j]: the CPU woke in bin j, earlier than the timer's bin.
+ *
+ * If the timer's state has missed more often than it has hit, the
+ * shallower state with the most intercepts is taken instead.  Finally, if
+ * most of the last INTERVALS idle periods were too short for the state
+ * picked, their average decides.  This copes with the periodic wakeups
+ * that the correction factors of the menu governor average away.
+ *
+ * Entering a power gated state and leaving it early costs energy and
+ * wake-up latency, while a clock gated state that could have been power
+ * gated wastes leakage; the too_deep and too_shallow counters of each
+ * state in sysfs show how often either happened.
+ */
+
+struct predict_bin {
+	unsigned int	hits;
+	unsigned int	misses;
+	unsigned int	intercepts;
+};
+
+struct predict_device {
+	int		last_state;
+	int		needs_update;
+	unsigned int	sleep_length_us;
+	struct predict_bin bins[CPUIDLE_STATE_MAX];
+	unsigned int	intervals[INTERVALS];
+	int		interval_idx;
+};
+
+static DEFINE_PER_CPU(struct predict_device, predict_devices);
+
+/* The bin of a duration: the deepest state whose residency it meets */
+static int predict_bin_of(struct cpuidle_device *dev, unsigned int us)
+{
+	int i;
+
+	for (i = dev->state_count - 1; i > 0; i--) {
+		if (dev->states[i].target_residency <= us)
+			break;
+	}
+	return i;
+}
+
+/**
+ * predict_update - learn from the last idle period
+ * @dev: the CPU
+ */
+static void predict_update(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	struct cpuidle_state *s = &dev->states[data->last_state];
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+	int timer_bin, idle_bin;
+	int i;
+
+	/* without residency measurements, assume the timer woke us */
+	if (unlikely(!(s->flags & CPUIDLE_FLAG_TIME_VALID)))
+		measured_us = data->sleep_length_us;
+	else if (measured_us > s->exit_latency)
+		measured_us -= s->exit_latency;
+
+	for (i = 0; i < dev->state_count; i++) {
+		struct predict_bin *bin = &data->bins[i];
+
+		bin->hits -= bin->hits >> DECAY_SHIFT;
+		bin->misses -= bin->misses >> DECAY_SHIFT;
+		bin->intercepts -= bin->intercepts >> DECAY_SHIFT;
+	}
+
+	timer_bin = predict_bin_of(dev, data->sleep_length_us);
+	idle_bin = predict_bin_of(dev, measured_us);
+	if (idle_bin < timer_bin) {
+		data->bins[timer_bin].misses += PULSE;
+		data->bins[idle_bin].intercepts += PULSE;
+	} else {
+		data->bins[timer_bin].hits += PULSE;
+	}
+
+	data->intervals[data->interval_idx++] = measured_us;
+	if (data->interval_idx >= INTERVALS)
+		data->interval_idx = 0;
+}
+
+/* The deepest usable state at most as deep as @max, meeting @us */
+static int predict_find_state(struct cpuidle_device *dev, int max,
+			      unsigned int us, int latency_req)
+{
+	int i, idx = 0;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i <= max; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->disabled || s->exit_latency > latency_req)
+			continue;
+		if (i > CPUIDLE_DRIVER_STATE_START && s->target_residency > us)
+			break;
+		idx = i;
+	}
+	return idx;
+}
+
+/**
+ * predict_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int predict_select(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int short_sum = 0;
+	int nr_short = 0;
+	struct timespec t;
+	int idx, i;
+
+	if (data->needs_update) {
+		predict_update(dev);
+		data->needs_update = 0;
+	}
+
+	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	data->sleep_length_us = t.tv_sec * USEC_PER_SEC +
+				t.tv_nsec / NSEC_PER_USEC;
+
+	data->last_state = 0;
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	/* the deepest state the next timer allows */
+	idx = predict_find_state(dev, dev->state_count - 1,
+				 data->sleep_length_us, latency_req);
+
+	/* usually woken before the timer: the likeliest shallower bin */
+	if (data->bins[idx].misses > data->bins[idx].hits) {
+		unsigned int max_intercepts = 0;
+		int shallow = 0;
+
+		for (i = CPUIDLE_DRIVER_STATE_START; i < idx; i++) {
+			if (dev->states[i].disabled)
+				continue;
+			if (data->bins[i].intercepts >= max_intercepts) {
+				max_intercepts = data->bins[i].intercepts;
+				shallow = i;
+			}
+		}
+		if (max_intercepts)
+			idx = shallow;
+	}
+
+	/* and if most recent idle periods were shorter than that, trust them */
+	for (i = 0; i < INTERVALS; i++) {
+		if (data->intervals[i] < dev->states[idx].target_residency) {
+			short_sum += data->intervals[i];
+			nr_short++;
+		}
+	}
+	if (nr_short > INTERVALS / 2)
+		idx = predict_find_state(dev, idx, short_sum / nr_short,
+					 latency_req);
+
+	data->last_state = idx;
+	return idx;
+}
+
+/**
+ * predict_reflect - records that the data structures need an update
+ * @dev: the CPU
+ * @index: the index of the state actually entered
+ */
+static void predict_reflect(struct cpuidle_device *dev, int index)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+
+	data->last_state = index;
+	if (index >= 0)
+		data->needs_update = 1;
+}
+
+/**
+ * predict_enable_device - resets a CPU's history
+ * @dev: the CPU
+ */
+static int predict_enable_device(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct predict_device));
+
+	return 0;
+}
+
+static struct cpuidle_governor predict_governor = {
+	.name =		"predict",
+	.rating =	30,
+	.enable =	predict_enable_device,
+	.select =	predict_select,
+	.reflect =	predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_predict - initializes the governor
+ */
+static int __init init_predict(void)
+{
+	return cpuidle_register_governor(&predict_governor);
+}
+
+/**
+ * exit_predict - exits the governor
+ */
+static void __exit exit_predict(void)
+{
+	cpuidle_unregister_governor(&predict_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_predict);
+module_exit(exit_predict);
@@ -272,6 +272,8 @@ define_show_state_function(power_usage)
 define_show_state_function(target_residency)
 define_show_state_ull_function(usage)
 define_show_state_ull_function(time)
+define_show_state_ull_function(too_deep)
+define_show_state_ull_function(too_shallow)
 define_show_state_str_function(name)
 define_show_state_str_function(desc)
 define_show_state_function(disabled)
@@ -284,6 +286,8 @@ define_one_state_ro(power, show_state_power_usage);
 define_one_state_ro(residency, show_state_target_residency);
 define_one_state_ro(usage, show_state_usage);
 define_one_state_ro(time, show_state_time);
+define_one_state_ro(too_deep, show_state_too_deep);
+define_one_state_ro(too_shallow, show_state_too_shallow);
 define_one_state_rw(disabled, show_state_disabled, store_state_disabled);
 
 static struct attribute *cpuidle_state_default_attrs[] = {
@@ -294,6 +298,8 @@ static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_residency.attr,
 	&attr_usage.attr,
 	&attr_time.attr,
+	&attr_too_deep.attr,
+	&attr_too_shallow.attr,
 	&attr_disabled.attr,
 	NULL
 };
@@ -0,0 +1,428 @@
+/*
+ * Predictive cpuquiet governor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/*
+ * Every sample_rate ms the number of CPUs needed is estimated from both
+ * the frequency scaled busy time of the online CPUs (as balanced does)
+ * and the average number of runnable threads (as runnable_threads does).
+ * A trend of that demand is kept and used to predict the demand horizon
+ * ms ahead, so a core can be woken as a burst builds up rather than
+ * once it is fully established.
+ *
+ * Decisions are weighed against a simple cost model:
+ *  - a core is woken when the work predicted not to fit on the online
+ *    cores over the horizon exceeds up_cost ms,
+ *  - a core is quiesced once the spare capacity that would remain
+ *    without it has added up to down_cost ms.
+ *
+ * cpufreq transitions update the per-CPU speed used to scale busy time,
+ * and a speed increase triggers an early sample.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuquiet.h>
+#include <linux/cpumask.h>
+#include <linux/module.h>
+#include <linux/cpufreq.h>
+#include <linux/pm_qos.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+
+typedef enum {
+	DISABLED,
+	IDLE,
+	RUNNING,
+} PREDICTIVE_STATE;
+
+struct predictive_cpu {
+	u64 idle_last;
+	u64 timestamp_last;
+	u64 integral_last;
+	u64 integral_timestamp;
+	/* busy fraction of the last sample, scaled to the max speed */
+	unsigned int load;
+	unsigned int cur_freq;
+	unsigned int max_freq;
+	bool sampled;
+};
+
+static DEFINE_PER_CPU(struct predictive_cpu, predictive_cpu);
+
+static struct work_struct predictive_work;
+static struct kobject *predictive_kobject;
+static struct timer_list predictive_timer;
+static PREDICTIVE_STATE predictive_state;
+
+/* configurable parameters */
+static unsigned int sample_rate = 20;		/* msec */
+static unsigned int horizon = 60;		/* msec */
+static unsigned int target_load = 80;		/* % of a core */
+static unsigned int up_cost = 4;		/* msec */
+static unsigned int down_cost = 300;		/* msec */
+
+/* All demand values are in CPUs, fixed point with FSHIFT bits */
+static unsigned int demand;
+static int trend;
+static unsigned int predicted;
+static unsigned long down_credit;
+static unsigned long last_sample;
+static int action;
+
+static DEFINE_MUTEX(predictive_lock);
+
+static unsigned int predictive_sample_cpu(unsigned int cpu,
+					  unsigned int *nr_run)
+{
+	struct predictive_cpu *pcpu = &per_cpu(predictive_cpu, cpu);
+	u64 idle, timestamp, elapsed, busy;
+	u64 integral, integral_timestamp, delta;
+
+	/* No policy yet when the CPU was offline at start */
+	if (!pcpu->max_freq) {
+		pcpu->cur_freq = cpufreq_quick_get(cpu);
+		pcpu->max_freq = cpufreq_quick_get_max(cpu);
+	}
+
+	idle = get_cpu_idle_time_us(cpu, &timestamp);
+	integral = nr_running_integral(cpu);
+	integral_timestamp = ktime_to_ns(ktime_get());
+
+	if (pcpu->sampled && timestamp > pcpu->timestamp_last) {
+		elapsed = timestamp - pcpu->timestamp_last;
+		busy = elapsed - min(elapsed, idle - pcpu->idle_last);
+		busy <<= FSHIFT;
+		do_div(busy, elapsed);
+		if (pcpu->max_freq && pcpu->cur_freq < pcpu->max_freq) {
+			busy *= pcpu->cur_freq;
+			do_div(busy, pcpu->max_freq);
+		}
+		pcpu->load = busy;
+
+		/* Same averaging of nr_running as runnable_threads */
+		if (integral < pcpu->integral_last)
+			delta = (ULLONG_MAX - pcpu->integral_last) + integral;
+		else
+			delta = integral - pcpu->integral_last;
+		elapsed = integral_timestamp - pcpu->integral_timestamp;
+		if (elapsed) {
+			do_div(delta, elapsed);
+			*nr_run += delta;
+		}
+	}
+
+	pcpu->idle_last = idle;
+	pcpu->timestamp_last = timestamp;
+	pcpu->integral_last = integral;
+	pcpu->integral_timestamp = integral_timestamp;
+	pcpu->sampled = true;
+
+	return pcpu->load;
+}
+
+static int predictive_get_action(unsigned int elapsed)
+{
+	unsigned int nr_cpus = num_online_cpus();
+	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
+	unsigned int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
+	unsigned long online = nr_cpus << FSHIFT;
+
+	if (nr_cpus > max_cpus && nr_cpus > min_cpus)
+		return -1;
+	if (nr_cpus < min_cpus)
+		return 1;
+
+	if (predicted > online) {
+		down_credit = 0;
+		/* work that would queue up over the horizon, in ms */
+		if (nr_cpus < max_cpus &&
+		    (predicted - online) * horizon >= (up_cost << FSHIFT))
+			return 1;
+		return 0;
+	}
+
+	if (nr_cpus > 1 && nr_cpus > min_cpus &&
+	    predicted < online - FIXED_1) {
+		/* spare capacity left with one core less, in ms */
+		down_credit += (online - FIXED_1 - predicted) * elapsed;
+		if (down_credit >= (down_cost << FSHIFT))
+			return -1;
+		return 0;
+	}
+
+	down_credit = 0;
+	return 0;
+}
+
+static void predictive_sample(unsigned long data)
+{
+	unsigned int cpu, load = 0, nr_run = 0, need, elapsed;
+	int delta, samples;
+
+	rmb();
+	if (predictive_state != RUNNING)
+		return;
+
+	for_each_online_cpu(cpu)
+		load += predictive_sample_cpu(cpu, &nr_run);
+
+	/* cores needed to run the load at target_load, or all runnables */
+	need = load * 100 / max(target_load, 1U);
+	need = max(need, nr_run);
+
+	/* demand and its per sample trend, both averaged over 4 samples */
+	delta = (int)need - (int)demand;
+	demand = (demand * 3 + need) / 4;
+	trend = (trend * 3 + delta) / 4;
+
+	samples = horizon / max(sample_rate, 1U);
+	delta = trend * samples;
+	if (delta < 0 && -delta > (int)demand)
+		predicted = 0;
+	else
+		predicted = demand + delta;
+
+	mod_timer(&predictive_timer,
+		  jiffies + msecs_to_jiffies(sample_rate));
+
+	/* Samples triggered by cpufreq come early */
+	elapsed = jiffies_to_msecs(jiffies - last_sample);
+	last_sample = jiffies;
+
+	action = predictive_get_action(min(elapsed, sample_rate));
+	if (action != 0) {
+		wmb();
+		schedule_work(&predictive_work);
+	}
+}
+
+static unsigned int get_lightest_loaded_cpu_n(void)
+{
+	unsigned int minload = UINT_MAX;
+	unsigned int cpu = nr_cpu_ids;
+	int i;
+
+	for_each_online_cpu(i) {
+		struct predictive_cpu *pcpu = &per_cpu(predictive_cpu, i);
+
+		if (i > 0 && minload > pcpu->load) {
+			cpu = i;
+			minload = pcpu->load;
+		}
+	}
+
+	return cpu;
+}
+
+static void predictive_work_func(struct work_struct *work)
+{
+	unsigned int cpu;
+
+	rmb();
+	if (predictive_state != RUNNING)
+		return;
+
+	if (action > 0) {
+		cpu = cpumask_next_zero(0, cpu_online_mask);
+		if (cpu < nr_cpu_ids)
+			cpuquiet_wake_cpu(cpu, false);
+	} else if (action < 0) {
+		cpu = get_lightest_loaded_cpu_n();
+		if (cpu < nr_cpu_ids)
+			cpuquiet_quiesence_cpu(cpu, false);
+	}
+	down_credit = 0;
+}
+
+static int predictive_cpufreq_transition(struct notifier_block *nb,
+	unsigned long state, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+	struct predictive_cpu *pcpu;
+
+	if (state != CPUFREQ_POSTCHANGE && state != CPUFREQ_RESUMECHANGE)
+		return NOTIFY_OK;
+
+	pcpu = &per_cpu(predictive_cpu, freqs->cpu);
+	pcpu->cur_freq = freqs->new;
+
+	/* Speed going up is the earliest sign of a burst, sample now */
+	if (freqs->new > freqs->old && predictive_state == RUNNING)
+		mod_timer(&predictive_timer, jiffies);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block predictive_cpufreq_nb = {
+	.notifier_call = predictive_cpufreq_transition,
+};
+
+static ssize_t show_predicted(struct cpuquiet_attribute *cattr, char *buf)
+{
+	return sprintf(buf, "%u.%02u\n", predicted >> FSHIFT,
+		       ((predicted & (FIXED_1 - 1)) * 100) >> FSHIFT);
+}
+
+CPQ_BASIC_ATTRIBUTE(sample_rate, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(horizon, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(target_load, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(up_cost, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(down_cost, 0644, uint);
+CPQ_ATTRIBUTE_CUSTOM(predicted, 0444, show_predicted, NULL);
+
+static struct attribute *predictive_attributes[] = {
+	&sample_rate_attr.attr,
+	&horizon_attr.attr,
+	&target_load_attr.attr,
+	&up_cost_attr.attr,
+	&down_cost_attr.attr,
+	&predicted_attr.attr,
+	NULL,
+};
+
+static const struct sysfs_ops predictive_sysfs_ops = {
+	.show = cpuquiet_auto_sysfs_show,
+	.store = cpuquiet_auto_sysfs_store,
+};
+
+static struct kobj_type ktype_predictive = {
+	.sysfs_ops = &predictive_sysfs_ops,
+	.default_attrs = predictive_attributes,
+};
+
+static int predictive_sysfs(void)
+{
+	int err;
+
+	predictive_kobject = kzalloc(sizeof(*predictive_kobject),
+				GFP_KERNEL);
+
+	if (!predictive_kobject)
+		return -ENOMEM;
+
+	err = cpuquiet_kobject_init(predictive_kobject, &ktype_predictive,
+				"predictive");
+
+	if (err)
+		kfree(predictive_kobject);
+
+	return err;
+}
+
+static void predictive_device_busy(void)
+{
+	mutex_lock(&predictive_lock);
+	if (predictive_state == RUNNING) {
+		predictive_state = IDLE;
+		cancel_work_sync(&predictive_work);
+		del_timer_sync(&predictive_timer);
+	}
+	mutex_unlock(&predictive_lock);
+}
+
+static void predictive_device_free(void)
+{
+	mutex_lock(&predictive_lock);
+	if (predictive_state == IDLE) {
+		predictive_state = RUNNING;
+		mod_timer(&predictive_timer, jiffies + 1);
+	}
+	mutex_unlock(&predictive_lock);
+}
+
+static void predictive_stop(void)
+{
+	cpufreq_unregister_notifier(&predictive_cpufreq_nb,
+		CPUFREQ_TRANSITION_NOTIFIER);
+
+	mutex_lock(&predictive_lock);
+
+	predictive_state = DISABLED;
+	del_timer_sync(&predictive_timer);
+	cancel_work_sync(&predictive_work);
+	kobject_put(predictive_kobject);
+
+	mutex_unlock(&predictive_lock);
+}
+
+static int predictive_start(void)
+{
+	int err, cpu;
+
+	err = predictive_sysfs();
+	if (err)
+		return err;
+
+	INIT_WORK(&predictive_work, predictive_work_func);
+
+	init_timer(&predictive_timer);
+	predictive_timer.function = predictive_sample;
+
+	for_each_possible_cpu(cpu) {
+		struct predictive_cpu *pcpu = &per_cpu(predictive_cpu, cpu);
+
+		memset(pcpu, 0, sizeof(*pcpu));
+		pcpu->cur_freq = cpufreq_quick_get(cpu);
+		pcpu->max_freq = cpufreq_quick_get_max(cpu);
+	}
+	demand = 0;
+	trend = 0;
+	predicted = 0;
+	down_credit = 0;
+	last_sample = jiffies;
+
+	cpufreq_register_notifier(&predictive_cpufreq_nb,
+		CPUFREQ_TRANSITION_NOTIFIER);
+
+	mutex_lock(&predictive_lock);
+	predictive_state = RUNNING;
+	mutex_unlock(&predictive_lock);
+
+	predictive_sample(0);
+
+	return 0;
+}
+
+struct cpuquiet_governor predictive_governor = {
+	.name			  = "predictive",
+	.start			  = predictive_start,
+	.device_free_notification = predictive_device_free,
+	.device_busy_notification = predictive_device_busy,
+	.stop			  = predictive_stop,
+	.owner			  = THIS_MODULE,
+};
+
+static int __init init_predictive(void)
+{
+	return cpuquiet_register_governor(&predictive_governor);
+}
+
+static void __exit exit_predictive(void)
+{
+	cpuquiet_unregister_governor(&predictive_governor);
+}
+
+MODULE_LICENSE("GPL");
+#ifdef CONFIG_CPUQUIET_DEFAULT_GOV_PREDICTIVE
+fs_initcall(init_predictive);
+#else
+module_init(init_predictive);
+#endif
+module_exit(exit_predictive);
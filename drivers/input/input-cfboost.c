@@ -72,11 +72,15 @@ static struct kernel_param_ops boost_freq_ops = {
 module_param_cb(boost_freq, &boost_freq_ops, &boost_freq, 0644);
 static unsigned long boost_time = 500; /* ms */
 module_param(boost_time, ulong, 0644);
+static unsigned int boost_cpus = 1;
+module_param(boost_cpus, uint, 0644);
 
 static void cfb_boost(struct kthread_work *w)
 {
 	trace_input_cfboost_params("boost_params", boost_freq, boost_time);
-	pm_qos_update_request_timeout(&core_req, 1, boost_time * 1000);
+	pm_qos_update_request_timeout(&core_req, boost_cpus, boost_time * 1000);
+	/* the min online CPUs notifiers have run by now */
+	trace_input_cfboost_qos("boost_qos", boost_cpus);
 
 	if (boost_freq > 0)
 		pm_qos_update_request_timeout(&freq_req, boost_freq,
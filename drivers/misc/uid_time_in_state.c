@@ -0,0 +1,149 @@
+/* drivers/misc/uid_time_in_state.c
+ *
+ * Per-UID CPU time at each CPU frequency.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/cred.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uid_stat.h>
+
+/*
+ * Exited tasks are folded into their uid's entry when they are released;
+ * live tasks are only added up when the file is read, so nothing here
+ * runs in the scheduler paths.
+ */
+static DEFINE_MUTEX(uid_lock);
+static LIST_HEAD(uid_list);
+
+struct uid_entry {
+	struct list_head link;
+	uid_t uid;
+	u64 dead[CPUFREQ_TASK_STATES_MAX];
+	u64 live[CPUFREQ_TASK_STATES_MAX];
+};
+
+/* Find the entry for @uid, or add one, keeping the list sorted by uid */
+static struct uid_entry *find_or_add_uid(uid_t uid, gfp_t gfp)
+{
+	struct uid_entry *entry;
+	struct uid_entry *new_uid;
+
+	list_for_each_entry(entry, &uid_list, link) {
+		if (entry->uid == uid)
+			return entry;
+		if (entry->uid > uid)
+			break;
+	}
+
+	new_uid = kzalloc(sizeof(struct uid_entry), gfp);
+	if (!new_uid)
+		return NULL;
+	new_uid->uid = uid;
+	list_add_tail(&new_uid->link, &entry->link);
+	return new_uid;
+}
+
+void uid_time_in_state_exit(struct task_struct *p)
+{
+	struct uid_entry *entry;
+	uid_t uid;
+
+	if (!p->max_state)
+		return;
+
+	rcu_read_lock();
+	uid = task_uid(p);
+	rcu_read_unlock();
+
+	mutex_lock(&uid_lock);
+	entry = find_or_add_uid(uid, GFP_KERNEL);
+	if (entry)
+		cpufreq_task_stats_add(p, entry->dead);
+	mutex_unlock(&uid_lock);
+}
+
+static int uid_time_in_state_show(struct seq_file *m, void *v)
+{
+	struct uid_entry *entry;
+	struct task_struct *g, *t;
+	const unsigned int *freqs;
+	unsigned int num;
+	int i;
+
+	freqs = cpufreq_task_stats_freqs(&num);
+
+	mutex_lock(&uid_lock);
+
+	list_for_each_entry(entry, &uid_list, link)
+		memset(entry->live, 0, sizeof(entry->live));
+
+	rcu_read_lock();
+	do_each_thread(g, t) {
+		if (!t->max_state)
+			continue;
+		entry = find_or_add_uid(task_uid(t), GFP_ATOMIC);
+		if (entry)
+			cpufreq_task_stats_add(t, entry->live);
+	} while_each_thread(g, t);
+	rcu_read_unlock();
+
+	seq_puts(m, "uid:");
+	for (i = 0; i < num; i++)
+		seq_printf(m, " %u", freqs[i]);
+	seq_putc(m, '\n');
+
+	list_for_each_entry(entry, &uid_list, link) {
+		seq_printf(m, "%d:", entry->uid);
+		for (i = 0; i < num; i++)
+			seq_printf(m, " %llu", (unsigned long long)
+				   nsec_to_clock_t(entry->dead[i] +
+						   entry->live[i]));
+		seq_putc(m, '\n');
+	}
+
+	mutex_unlock(&uid_lock);
+	return 0;
+}
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_time_in_state_show, NULL);
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init uid_time_in_state_init(void)
+{
+	if (!proc_create("uid_time_in_state", S_IRUGO, NULL,
+			 &uid_time_in_state_fops)) {
+		pr_err("uid_time_in_state: failed to create proc entry\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+__initcall(uid_time_in_state_init);
@@ -27,7 +27,10 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/pagemap.h>
+#include <linux/pagevec.h>
 #include <linux/shmem_fs.h>
+#include <linux/spinlock.h>
 #include "ashmem.h"
 
 #define ASHMEM_NAME_PREFIX "dev/ashmem/"
@@ -37,7 +40,7 @@
 /*
  * ashmem_area - anonymous shared memory area
  * Lifecycle: From our parent file's open() until its release()
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its own `mutex'
  * Big Note: Mappings do NOT pin this structure; it dies on close()
  */
 struct ashmem_area {
@@ -46,12 +49,14 @@ struct ashmem_area {
 	struct file *file;		 /* the shmem-based backing file */
 	size_t size;			 /* size of the mapping, in bytes */
 	unsigned long prot_mask;	 /* allowed prot bits, as vm_flags */
+	struct mutex mutex;		 /* protects all of the above */
 };
 
 /*
  * ashmem_range - represents an interval of unpinned (evictable) pages
  * Lifecycle: From unpin to pin
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its area's `mutex'. `lru', `resident' and
+ * `purged' of ranges on the LRU are also protected by `ashmem_lru_lock'.
  */
 struct ashmem_range {
 	struct list_head lru;		/* entry in LRU list */
@@ -59,21 +64,25 @@ struct ashmem_range {
 	struct ashmem_area *asma;	/* associated area */
 	size_t pgstart;			/* starting page, inclusive */
 	size_t pgend;			/* ending page, inclusive */
+	size_t resident;		/* pages in memory at unpin time */
 	unsigned int purged;		/* ASHMEM_NOT or ASHMEM_WAS_PURGED */
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
+/* LRU list of unpinned ranges, protected by ashmem_lru_lock */
 static LIST_HEAD(ashmem_lru_list);
 
-/* Count of pages on our LRU list, protected by ashmem_mutex */
+/* Resident pages and ranges on our LRU list, protected by ashmem_lru_lock */
 static unsigned long lru_count;
+static unsigned long lru_ranges;
 
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_lru_lock - protects the LRU list. Nothing may sleep under it.
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * Lock Ordering: asma->mutex -> ashmem_lru_lock. The shrinker, which
+ * goes the other way, only ever trylocks an area's mutex.
+ * asma->mutex -> i_mutex -> i_alloc_sem
  */
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -102,16 +111,49 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 #define PROT_MASK		(PROT_EXEC | PROT_READ | PROT_WRITE)
 
+/*
+ * range_resident - count the pages of a range that are in memory. Only
+ * those are freed by purging; untouched and swapped out pages are not.
+ */
+static size_t range_resident(struct ashmem_area *asma, size_t start,
+			     size_t end)
+{
+	struct address_space *mapping = asma->file->f_mapping;
+	struct pagevec pvec;
+	pgoff_t index = start;
+	size_t count = 0;
+	unsigned int i, nr;
+
+	pagevec_init(&pvec, 0);
+	while (index <= end &&
+	       (nr = pagevec_lookup(&pvec, mapping, index, PAGEVEC_SIZE))) {
+		for (i = 0; i < nr; i++) {
+			if (pvec.pages[i]->index > end)
+				break;
+			count++;
+		}
+		index = pvec.pages[nr - 1]->index + 1;
+		pagevec_release(&pvec);
+		cond_resched();
+	}
+
+	return count;
+}
+
+/* Caller must hold ashmem_lru_lock */
 static inline void lru_add(struct ashmem_range *range)
 {
 	list_add_tail(&range->lru, &ashmem_lru_list);
-	lru_count += range_size(range);
+	lru_count += range->resident;
+	lru_ranges++;
 }
 
+/* Caller must hold ashmem_lru_lock */
 static inline void lru_del(struct ashmem_range *range)
 {
 	list_del(&range->lru);
-	lru_count -= range_size(range);
+	lru_count -= range->resident;
+	lru_ranges--;
 }
 
 /*
@@ -123,7 +165,7 @@ static inline void lru_del(struct ashmem_range *range)
  * 'start' - starting page, inclusive
  * 'end' - ending page, inclusive
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int range_alloc(struct ashmem_area *asma,
 		       struct ashmem_range *prev_range, unsigned int purged,
@@ -139,38 +181,51 @@ static int range_alloc(struct ashmem_area *asma,
 	range->pgstart = start;
 	range->pgend = end;
 	range->purged = purged;
+	if (range_on_lru(range))
+		range->resident = range_resident(asma, start, end);
 
 	list_add_tail(&range->unpinned, &prev_range->unpinned);
 
+	spin_lock(&ashmem_lru_lock);
 	if (range_on_lru(range))
 		lru_add(range);
+	spin_unlock(&ashmem_lru_lock);
 
 	return 0;
 }
 
+/* Caller must hold asma->mutex. */
 static void range_del(struct ashmem_range *range)
 {
 	list_del(&range->unpinned);
+	spin_lock(&ashmem_lru_lock);
 	if (range_on_lru(range))
 		lru_del(range);
+	spin_unlock(&ashmem_lru_lock);
 	kmem_cache_free(ashmem_range_cachep, range);
 }
 
 /*
  * range_shrink - shrinks a range
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static inline void range_shrink(struct ashmem_range *range,
 				size_t start, size_t end)
 {
-	size_t pre = range_size(range);
+	size_t resident = 0;
+
+	if (range_on_lru(range))
+		resident = range_resident(range->asma, start, end);
 
+	spin_lock(&ashmem_lru_lock);
 	range->pgstart = start;
 	range->pgend = end;
-
-	if (range_on_lru(range))
-		lru_count -= pre - range_size(range);
+	if (range_on_lru(range)) {
+		lru_count -= range->resident - resident;
+		range->resident = resident;
+	}
+	spin_unlock(&ashmem_lru_lock);
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -187,6 +242,7 @@ static int ashmem_open(struct inode *inode, struct file *file)
 		return -ENOMEM;
 
 	INIT_LIST_HEAD(&asma->unpinned_list);
+	mutex_init(&asma->mutex);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
 	file->private_data = asma;
@@ -199,10 +255,10 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	if (asma->file)
 		fput(asma->file);
@@ -217,7 +273,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0)
@@ -236,7 +292,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	asma->file->f_pos = *pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -245,7 +301,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -265,7 +321,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -281,7 +337,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -324,10 +380,58 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_flags |= VM_CAN_NONLINEAR;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
+/*
+ * ashmem_purge_area - purge the unpinned ranges of 'asma' still on the LRU,
+ * until 'nr_to_scan' pages are gone. Returns the number of pages purged.
+ *
+ * Caller must hold asma->mutex and ashmem_lru_lock; the latter is dropped
+ * while the pages are being freed.
+ */
+static unsigned long ashmem_purge_area(struct ashmem_area *asma,
+				       unsigned long nr_to_scan)
+{
+	struct inode *inode = asma->file->f_dentry->d_inode;
+	struct ashmem_range *range, *next;
+	unsigned long freed = 0;
+	LIST_HEAD(batch);
+
+	/* Take them off the LRU together, under one lock round trip */
+	list_for_each_entry(range, &asma->unpinned_list, unpinned) {
+		if (!range_on_lru(range))
+			continue;
+		lru_del(range);
+		range->purged = ASHMEM_WAS_PURGED;
+		list_add_tail(&range->lru, &batch);
+		freed += range->resident;
+		if (freed >= nr_to_scan)
+			break;
+	}
+	spin_unlock(&ashmem_lru_lock);
+
+	/*
+	 * The ranges are sorted by descending page, so neighbours that
+	 * touch can be truncated with a single call.
+	 */
+	list_for_each_entry_safe(range, next, &batch, lru) {
+		size_t pgstart = range->pgstart;
+
+		while (&next->lru != &batch && next->pgend + 1 == pgstart) {
+			pgstart = next->pgstart;
+			next = list_entry(next->lru.next, struct ashmem_range,
+					  lru);
+		}
+		vmtruncate_range(inode, (loff_t)pgstart * PAGE_SIZE,
+				 (loff_t)(range->pgend + 1) * PAGE_SIZE - 1);
+	}
+
+	spin_lock(&ashmem_lru_lock);
+	return freed;
+}
+
 /*
  * ashmem_shrink - our cache shrinker, called from mm/vmscan.c :: shrink_slab
  *
@@ -339,37 +443,49 @@ out:
  * Return value is the number of objects (pages) remaining, or -1 if we cannot
  * proceed without risk of deadlock (due to gfp_mask).
  *
- * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
- * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * We approximate LRU via least-recently-unpinned, purging all unpinned
+ * ranges of the area that owns the oldest range at once, until we hit
+ * 'nr_to_scan' pages freed. Only pages that were resident when their range
+ * was unpinned are counted. Areas that are busy are skipped.
  */
 static int ashmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range;
+	struct ashmem_area *asma;
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	unsigned long freed, tries;
+	int ret;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (sc->nr_to_scan && !(sc->gfp_mask & __GFP_FS))
 		return -1;
 	if (!sc->nr_to_scan)
-		return lru_count;
+		return min_t(unsigned long, lru_count, INT_MAX);
 
-	mutex_lock(&ashmem_mutex);
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		struct inode *inode = range->asma->file->f_dentry->d_inode;
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE - 1;
+	spin_lock(&ashmem_lru_lock);
+	tries = lru_ranges;
+	while (nr_to_scan && tries-- && !list_empty(&ashmem_lru_list)) {
+		range = list_first_entry(&ashmem_lru_list, struct ashmem_range,
+					 lru);
+		asma = range->asma;
 
-		vmtruncate_range(inode, start, end);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+		/*
+		 * The area's owner may be allocating memory with its mutex
+		 * held, so never wait for it here.
+		 */
+		if (!mutex_trylock(&asma->mutex)) {
+			list_move_tail(&range->lru, &ashmem_lru_list);
+			continue;
+		}
+		freed = ashmem_purge_area(asma, nr_to_scan);
+		mutex_unlock(&asma->mutex);
 
-		sc->nr_to_scan -= range_size(range);
-		if (sc->nr_to_scan <= 0)
-			break;
+		nr_to_scan -= min(freed, nr_to_scan);
 	}
-	mutex_unlock(&ashmem_mutex);
+	ret = min_t(unsigned long, lru_count, INT_MAX);
+	spin_unlock(&ashmem_lru_lock);
 
-	return lru_count;
+	return ret;
 }
 
 static struct shrinker ashmem_shrinker = {
@@ -381,7 +497,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -396,7 +512,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -404,7 +520,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file)) {
@@ -418,7 +534,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	asma->name[ASHMEM_FULL_NAME_LEN-1] = '\0';
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -427,7 +543,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 		size_t len;
 
@@ -444,7 +560,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 					  sizeof(ASHMEM_NAME_DEF))))
 			ret = -EFAULT;
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -453,7 +569,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -519,7 +635,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -554,7 +670,7 @@ restart:
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
@@ -603,7 +719,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -617,7 +733,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -636,10 +752,12 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		break;
 	case ASHMEM_SET_SIZE:
 		ret = -EINVAL;
+		mutex_lock(&asma->mutex);
 		if (!asma->file) {
 			ret = 0;
 			asma->size = (size_t) arg;
 		}
+		mutex_unlock(&asma->mutex);
 		break;
 	case ASHMEM_GET_SIZE:
 		ret = asma->size;
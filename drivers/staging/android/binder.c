@@ -281,6 +281,18 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+/*
+ * Transactions whose data and offsets fit in BINDER_SMALL_DATA_SIZE are
+ * carved from fixed-size slots at the start of the mmap area.  Those pages
+ * stay mapped for the lifetime of the proc, so small transactions never
+ * touch the page tables or the free buffer tree.
+ */
+#define BINDER_SMALL_DATA_SIZE	256
+#define BINDER_SMALL_SLOT_SIZE	ALIGN(sizeof(struct binder_buffer) + \
+				      BINDER_SMALL_DATA_SIZE, sizeof(void *))
+#define BINDER_SMALL_AREA_SIZE	(4 * PAGE_SIZE)
+#define BINDER_SMALL_BUFFERS	(BINDER_SMALL_AREA_SIZE / BINDER_SMALL_SLOT_SIZE)
+
 struct binder_proc {
 	struct hlist_node proc_node;
 	struct rb_root threads;
@@ -294,13 +306,23 @@ struct binder_proc {
 	struct files_struct *files;
 	struct hlist_node deferred_work_node;
 	int deferred_work;
+	int tmp_ref;
+	int is_dead;
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	/*
+	 * alloc_lock protects the buffer allocator state below and may be
+	 * taken with or without binder_main_lock, but never the other way
+	 * round.  tmp_ref and is_dead are protected by binder_main_lock.
+	 */
+	struct mutex alloc_lock;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	void *small_buffers;
+	DECLARE_BITMAP(small_used, BINDER_SMALL_BUFFERS);
 
 	struct page **pages;
 	size_t buffer_size;
@@ -530,9 +552,24 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static int binder_is_small_buffer(struct binder_proc *proc,
+				  struct binder_buffer *buffer)
+{
+	return proc->small_buffers && (void *)buffer >= proc->small_buffers &&
+		(void *)buffer < proc->small_buffers + BINDER_SMALL_AREA_SIZE;
+}
+
+static struct binder_buffer *binder_small_buffer(struct binder_proc *proc,
+						 int slot)
+{
+	return proc->small_buffers + slot * BINDER_SMALL_SLOT_SIZE;
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
+	if (binder_is_small_buffer(proc, buffer))
+		return BINDER_SMALL_SLOT_SIZE - sizeof(struct binder_buffer);
 	if (list_is_last(&buffer->entry, &proc->buffers))
 		return proc->buffer + proc->buffer_size - (void *)buffer->data;
 	else
@@ -601,13 +638,28 @@ static void binder_insert_allocated_buffer(struct binder_proc *proc,
 static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 						  void __user *user_ptr)
 {
-	struct rb_node *n = proc->allocated_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	struct binder_buffer *kern_ptr;
 
 	kern_ptr = user_ptr - proc->user_buffer_offset
 		- offsetof(struct binder_buffer, data);
 
+	mutex_lock(&proc->alloc_lock);
+	if (binder_is_small_buffer(proc, kern_ptr)) {
+		size_t off = (void *)kern_ptr - proc->small_buffers;
+		int slot = off / BINDER_SMALL_SLOT_SIZE;
+
+		buffer = NULL;
+		if (off % BINDER_SMALL_SLOT_SIZE == 0 &&
+		    slot < BINDER_SMALL_BUFFERS &&
+		    test_bit(slot, proc->small_used))
+			buffer = kern_ptr;
+		mutex_unlock(&proc->alloc_lock);
+		return buffer;
+	}
+
+	n = proc->allocated_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(buffer->free);
@@ -617,9 +669,10 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 		else if (kern_ptr > buffer)
 			n = n->rb_right;
 		else
-			return buffer;
+			break;
 	}
-	return NULL;
+	mutex_unlock(&proc->alloc_lock);
+	return n ? buffer : NULL;
 }
 
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
@@ -727,9 +780,23 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static struct binder_buffer *binder_alloc_small_buf(struct binder_proc *proc)
+{
+	int slot;
+
+	if (!proc->small_buffers)
+		return NULL;
+	slot = find_first_zero_bit(proc->small_used, BINDER_SMALL_BUFFERS);
+	if (slot >= BINDER_SMALL_BUFFERS)
+		return NULL;
+	__set_bit(slot, proc->small_used);
+	return binder_small_buffer(proc, slot);
+}
+
+static struct binder_buffer *binder_alloc_buf_locked(struct binder_proc *proc,
+						     size_t data_size,
+						     size_t offsets_size,
+						     int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -762,6 +829,18 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	if (size <= BINDER_SMALL_DATA_SIZE) {
+		buffer = binder_alloc_small_buf(proc);
+		if (buffer) {
+			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+				     "binder: %d: binder_alloc_buf size %zd "
+				     "got small buffer %p\n", proc->pid, size,
+				     buffer);
+			buffer->free = 0;
+			goto done;
+		}
+	}
+
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -819,9 +898,14 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_alloc_buf size %zd got "
 		     "%p\n", proc->pid, size, buffer);
+done:
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
 	buffer->async_transaction = is_async;
+	/* not visible to BC_FREE_BUFFER until the transaction claims it */
+	buffer->allow_user_free = 0;
+	buffer->transaction = NULL;
+	buffer->target_node = NULL;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
@@ -833,6 +917,23 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+/*
+ * May be called without binder_main_lock.  The caller must hold a tmp_ref
+ * on proc so that its pages and buffers outlive the call.
+ */
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&proc->alloc_lock);
+	buffer = binder_alloc_buf_locked(proc, data_size, offsets_size,
+					 is_async);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -890,8 +991,8 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void binder_free_buf_locked(struct binder_proc *proc,
+				   struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
@@ -919,6 +1020,16 @@ static void binder_free_buf(struct binder_proc *proc,
 			     proc->free_async_space);
 	}
 
+	if (binder_is_small_buffer(proc, buffer)) {
+		int slot = ((void *)buffer - proc->small_buffers) /
+			BINDER_SMALL_SLOT_SIZE;
+
+		BUG_ON(!test_bit(slot, proc->small_used));
+		buffer->free = 1;
+		__clear_bit(slot, proc->small_used);
+		return;
+	}
+
 	binder_update_page_range(proc, 0,
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
@@ -945,6 +1056,14 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->alloc_lock);
+	binder_free_buf_locked(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -1397,6 +1516,96 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+static void binder_free_proc(struct binder_proc *proc)
+{
+	struct binder_transaction *t;
+	struct rb_node *n;
+	int buffers, page_count;
+
+	BUG_ON(!proc->is_dead);
+
+	buffers = 0;
+	while ((n = rb_first(&proc->allocated_buffers))) {
+		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
+							rb_node);
+		t = buffer->transaction;
+		if (t) {
+			t->buffer = NULL;
+			buffer->transaction = NULL;
+			printk(KERN_ERR "binder: release proc %d, "
+			       "transaction %d, not freed\n",
+			       proc->pid, t->debug_id);
+			/*BUG();*/
+		}
+		binder_free_buf(proc, buffer);
+		buffers++;
+	}
+
+	if (proc->small_buffers) {
+		int slot;
+
+		for_each_set_bit(slot, proc->small_used, BINDER_SMALL_BUFFERS) {
+			struct binder_buffer *buffer;
+
+			buffer = binder_small_buffer(proc, slot);
+			t = buffer->transaction;
+			if (t) {
+				t->buffer = NULL;
+				buffer->transaction = NULL;
+				printk(KERN_ERR "binder: release proc %d, "
+				       "transaction %d, not freed\n",
+				       proc->pid, t->debug_id);
+			}
+			binder_free_buf(proc, buffer);
+			buffers++;
+		}
+	}
+
+	binder_stats_deleted(BINDER_STAT_PROC);
+
+	page_count = 0;
+	if (proc->pages) {
+		int i;
+		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+			if (proc->pages[i]) {
+				void *page_addr = proc->buffer + i * PAGE_SIZE;
+				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+					     "binder_release: %d: "
+					     "page %d at %p not freed\n",
+					     proc->pid, i,
+					     page_addr);
+				unmap_kernel_range((unsigned long)page_addr,
+					PAGE_SIZE);
+				__free_page(proc->pages[i]);
+				page_count++;
+			}
+		}
+		kfree(proc->pages);
+		vfree(proc->buffer);
+	}
+
+	put_task_struct(proc->tsk);
+
+	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+		     "binder_release: %d buffers %d, pages %d\n",
+		     proc->pid, buffers, page_count);
+
+	kfree(proc);
+}
+
+/*
+ * tmp_ref keeps a proc's buffers and pages alive while binder_main_lock is
+ * dropped around an allocation in it.  The open file holds one reference,
+ * which binder_deferred_release() drops after marking the proc dead.
+ * Called with binder_main_lock held.
+ */
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (--proc->tmp_ref == 0)
+		binder_free_proc(proc);
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply)
@@ -1411,6 +1620,7 @@ static void binder_transaction(struct binder_proc *proc,
 	wait_queue_head_t *target_wait;
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
+	const char *copy_failed = NULL;
 	uint32_t return_error;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
@@ -1503,21 +1713,8 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1561,41 +1758,77 @@ static void binder_transaction(struct binder_proc *proc,
 		t->from = NULL;
 	t->sender_euid = proc->tsk->cred->euid;
 	t->to_proc = target_proc;
-	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
 
-	trace_binder_transaction(reply, t, target_node);
+	/*
+	 * Populating the target's pages and copying the payload do not need
+	 * binder_main_lock; only the target's alloc_lock is held for the
+	 * allocation.  The node and the proc are pinned across the window,
+	 * and everything else about the target is rechecked afterwards.
+	 */
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+	target_proc->tmp_ref++;
+	binder_unlock(__func__);
 
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+	if (t->buffer) {
+		offp = (size_t *)(t->buffer->data +
+				  ALIGN(tr->data_size, sizeof(void *)));
+		if (copy_from_user(t->buffer->data, tr->data.ptr.buffer,
+				   tr->data_size))
+			copy_failed = "data";
+		else if (copy_from_user(offp, tr->data.ptr.offsets,
+					tr->offsets_size))
+			copy_failed = "offsets";
+	}
+
+	binder_lock(__func__);
 	if (t->buffer == NULL) {
-		return_error = BR_FAILED_REPLY;
+		if (target_node)
+			binder_dec_node(target_node, 1, 0);
+		return_error = target_proc->is_dead ?
+			BR_DEAD_REPLY : BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
 	trace_binder_transaction_alloc_buf(t->buffer);
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
-
-	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+	if (copy_failed) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
-			"data ptr\n", proc->pid, thread->pid);
+			"%s ptr\n", proc->pid, thread->pid, copy_failed);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("binder: %d:%d got transaction with invalid "
-			"offsets ptr\n", proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+	/* in_reply_to->from is cleared if the target thread exited */
+	if (target_proc->is_dead ||
+	    (reply && in_reply_to->from != target_thread)) {
+		return_error = BR_DEAD_REPLY;
+		goto err_dead_target;
+	}
+	if (!reply && !(tr->flags & TF_ONE_WAY)) {
+		struct binder_transaction *tmp;
+
+		for (tmp = thread->transaction_stack; tmp;
+		     tmp = tmp->from_parent)
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
+	}
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
 	}
+	t->to_thread = target_thread;
+	trace_binder_transaction(reply, t, target_node);
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1769,6 +2002,7 @@ static void binder_transaction(struct binder_proc *proc,
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	binder_proc_dec_tmpref(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1779,12 +2013,14 @@ err_binder_get_ref_failed:
 err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
+err_dead_target:
 err_copy_data_failed:
 	trace_binder_transaction_failed_buffer_release(t->buffer);
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
 err_binder_alloc_buf_failed:
+	binder_proc_dec_tmpref(target_proc);
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 err_alloc_tcomplete_failed:
@@ -2865,6 +3101,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
 	struct binder_buffer *buffer;
+	size_t small_size = 0;
 
 	if ((vma->vm_end - vma->vm_start) > SZ_4M)
 		vma->vm_end = vma->vm_start + SZ_4M;
@@ -2918,12 +3155,22 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
 
-	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + PAGE_SIZE, vma)) {
+	/*
+	 * Reserve the small transaction slots in front of the general
+	 * allocator, unless the mapping is too small to spare them.
+	 */
+	if (proc->buffer_size >= 4 * BINDER_SMALL_AREA_SIZE)
+		small_size = BINDER_SMALL_AREA_SIZE;
+
+	if (binder_update_page_range(proc, 1, proc->buffer,
+				     proc->buffer + small_size + PAGE_SIZE, vma)) {
 		ret = -ENOMEM;
 		failure_string = "alloc small buf";
 		goto err_alloc_small_buf_failed;
 	}
-	buffer = proc->buffer;
+	if (small_size)
+		proc->small_buffers = proc->buffer;
+	buffer = proc->buffer + small_size;
 	INIT_LIST_HEAD(&proc->buffers);
 	list_add(&buffer->entry, &proc->buffers);
 	buffer->free = 1;
@@ -2968,6 +3215,8 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
+	mutex_init(&proc->alloc_lock);
+	proc->tmp_ref = 1;
 	proc->default_priority = task_nice(current);
 
 	binder_lock(__func__);
@@ -3030,9 +3279,8 @@ static int binder_release(struct inode *nodp, struct file *filp)
 static void binder_deferred_release(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
-	struct binder_transaction *t;
 	struct rb_node *n;
-	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
+	int threads, nodes, incoming_refs, outgoing_refs, active_transactions;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
@@ -3100,57 +3348,15 @@ static void binder_deferred_release(struct binder_proc *proc)
 	}
 	binder_release_work(&proc->todo);
 	binder_release_work(&proc->delivered_death);
-	buffers = 0;
-
-	while ((n = rb_first(&proc->allocated_buffers))) {
-		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
-							rb_node);
-		t = buffer->transaction;
-		if (t) {
-			t->buffer = NULL;
-			buffer->transaction = NULL;
-			printk(KERN_ERR "binder: release proc %d, "
-			       "transaction %d, not freed\n",
-			       proc->pid, t->debug_id);
-			/*BUG();*/
-		}
-		binder_free_buf(proc, buffer);
-		buffers++;
-	}
-
-	binder_stats_deleted(BINDER_STAT_PROC);
-
-	page_count = 0;
-	if (proc->pages) {
-		int i;
-		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			if (proc->pages[i]) {
-				void *page_addr = proc->buffer + i * PAGE_SIZE;
-				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-					     "binder_release: %d: "
-					     "page %d at %p not freed\n",
-					     proc->pid, i,
-					     page_addr);
-				unmap_kernel_range((unsigned long)page_addr,
-					PAGE_SIZE);
-				__free_page(proc->pages[i]);
-				page_count++;
-			}
-		}
-		kfree(proc->pages);
-		vfree(proc->buffer);
-	}
-
-	put_task_struct(proc->tsk);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
 		     "binder_release: %d threads %d, nodes %d (ref %d), "
-		     "refs %d, active transactions %d, buffers %d, "
-		     "pages %d\n",
+		     "refs %d, active transactions %d\n",
 		     proc->pid, threads, nodes, incoming_refs, outgoing_refs,
-		     active_transactions, buffers, page_count);
+		     active_transactions);
 
-	kfree(proc);
+	proc->is_dead = 1;
+	binder_proc_dec_tmpref(proc);
 }
 
 static void binder_deferred_func(struct work_struct *work)
@@ -3185,7 +3391,7 @@ static void binder_deferred_func(struct work_struct *work)
 			binder_deferred_flush(proc);
 
 		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); /* frees proc */
+			binder_deferred_release(proc); /* may free proc */
 
 		binder_unlock(__func__);
 		if (files)
@@ -3348,6 +3554,7 @@ static void print_binder_proc(struct seq_file *m,
 	struct rb_node *n;
 	size_t start_pos = m->count;
 	size_t header_pos;
+	int i;
 
 	seq_printf(m, "proc %d\n", proc->pid);
 	header_pos = m->count;
@@ -3368,9 +3575,16 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	if (proc->small_buffers) {
+		for_each_set_bit(i, proc->small_used, BINDER_SMALL_BUFFERS)
+			print_binder_buffer(m, "  small buffer",
+					    binder_small_buffer(proc, i));
+	}
+	mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3500,8 +3714,12 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	if (proc->small_buffers)
+		count += bitmap_weight(proc->small_used, BINDER_SMALL_BUFFERS);
+	mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
 
 	count = 0;
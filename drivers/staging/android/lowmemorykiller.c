@@ -39,6 +39,7 @@
 #include <linux/sched.h>
 #include <linux/swap.h>
 #include <linux/rcupdate.h>
+#include <linux/rculist_nulls.h>
 #include <linux/notifier.h>
 
 static uint32_t lowmem_debug_level = 1;
@@ -58,6 +59,27 @@ static int lowmem_minfree[6] = {
 static int lowmem_minfree_size = 4;
 
 static unsigned long lowmem_deathpending_timeout;
+static struct pid *lowmem_deathpending;
+static DEFINE_SPINLOCK(lowmem_deathpending_lock);
+
+/*
+ * Processes are kept in one bucket per oom_score_adj value, so that
+ * lowmem_shrink() only looks at processes with the highest oom_score_adj
+ * instead of walking the whole task list. Buckets are RCU lists, written
+ * under lowmem_adj_lock. A process can move to another bucket while a
+ * reader walks it, so each bucket ends in a distinct 'nulls' value and
+ * readers that end up somewhere else start over.
+ *
+ * lowmem_adj_lock is taken inside tasklist_lock, siglock and task_lock,
+ * so nothing else may be locked while holding it.
+ */
+#define LOWMEM_ADJ_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+
+static struct hlist_nulls_head lowmem_adj_buckets[LOWMEM_ADJ_BUCKETS];
+static DECLARE_BITMAP(lowmem_adj_used, LOWMEM_ADJ_BUCKETS);
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+/* set once the buckets are initialized, which happens at the first fork */
+static bool lowmem_adj_ready;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -65,16 +87,176 @@ static unsigned long lowmem_deathpending_timeout;
 			pr_info(x);			\
 	} while (0)
 
+static inline int lowmem_adj_to_bucket(int oom_score_adj)
+{
+	return oom_score_adj - OOM_SCORE_ADJ_MIN;
+}
+
+static void __lowmem_adj_index_add(struct signal_struct *sig)
+{
+	int b = lowmem_adj_to_bucket(sig->oom_score_adj);
+
+	sig->lowmem_adj_bucket = b;
+	hlist_nulls_add_head_rcu(&sig->lowmem_adj_node,
+				 &lowmem_adj_buckets[b]);
+	__set_bit(b, lowmem_adj_used);
+}
+
+static void __lowmem_adj_index_del(struct signal_struct *sig)
+{
+	int b = sig->lowmem_adj_bucket;
+
+	hlist_nulls_del_init_rcu(&sig->lowmem_adj_node);
+	if (hlist_nulls_empty(&lowmem_adj_buckets[b]))
+		__clear_bit(b, lowmem_adj_used);
+}
+
+void lowmem_adj_index_add(struct task_struct *p)
+{
+	int i;
+
+	if (p->flags & PF_KTHREAD)
+		return;
+
+	spin_lock(&lowmem_adj_lock);
+	if (unlikely(!lowmem_adj_ready)) {
+		for (i = 0; i < LOWMEM_ADJ_BUCKETS; i++)
+			INIT_HLIST_NULLS_HEAD(&lowmem_adj_buckets[i], i);
+		smp_wmb();
+		lowmem_adj_ready = true;
+	}
+	if (hlist_nulls_unhashed(&p->signal->lowmem_adj_node))
+		__lowmem_adj_index_add(p->signal);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+void lowmem_adj_index_del(struct task_struct *p)
+{
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_nulls_unhashed(&p->signal->lowmem_adj_node))
+		__lowmem_adj_index_del(p->signal);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+void lowmem_adj_index_update(struct task_struct *p)
+{
+	struct signal_struct *sig = p->signal;
+
+	spin_lock(&lowmem_adj_lock);
+	if (!hlist_nulls_unhashed(&sig->lowmem_adj_node) &&
+	    sig->lowmem_adj_bucket != lowmem_adj_to_bucket(sig->oom_score_adj)) {
+		__lowmem_adj_index_del(sig);
+		__lowmem_adj_index_add(sig);
+	}
+	spin_unlock(&lowmem_adj_lock);
+}
+
+/*
+ * Is the last process we killed still on its way out? Called under
+ * rcu_read_lock().
+ */
+static bool lowmem_death_pending(void)
+{
+	struct task_struct *p;
+	bool pending = false;
+
+	if (time_after(jiffies, lowmem_deathpending_timeout))
+		return false;
+
+	spin_lock(&lowmem_deathpending_lock);
+	p = pid_task(lowmem_deathpending, PIDTYPE_PID);
+	if (p && test_tsk_thread_flag(p, TIF_MEMDIE))
+		pending = true;
+	spin_unlock(&lowmem_deathpending_lock);
+
+	return pending;
+}
+
+static void lowmem_set_death_pending(struct task_struct *p)
+{
+	struct pid *old;
+
+	spin_lock(&lowmem_deathpending_lock);
+	old = lowmem_deathpending;
+	lowmem_deathpending = get_pid(task_pid(p));
+	lowmem_deathpending_timeout = jiffies + HZ;
+	spin_unlock(&lowmem_deathpending_lock);
+	put_pid(old);
+}
+
+struct lowmem_victim {
+	struct task_struct *task;
+	int tasksize;
+	int oom_score_adj;
+};
+
+/*
+ * Pick the largest process of bucket 'b' that beats 'victim'. Returns
+ * -EBUSY if a process that is being killed was found. Called under
+ * rcu_read_lock().
+ */
+static int lowmem_scan_bucket(int b, int min_score_adj,
+			      struct lowmem_victim *victim)
+{
+	struct signal_struct *sig;
+	struct hlist_nulls_node *node;
+	struct task_struct *tsk, *p;
+	int oom_score_adj, tasksize;
+
+restart:
+	hlist_nulls_for_each_entry_rcu(sig, node, &lowmem_adj_buckets[b],
+				       lowmem_adj_node) {
+		tsk = pid_task(sig->leader_pid, PIDTYPE_PID);
+		if (!tsk || (tsk->flags & PF_KTHREAD))
+			continue;
+
+		p = find_lock_task_mm(tsk);
+		if (!p)
+			continue;
+
+		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
+		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+			task_unlock(p);
+			return -EBUSY;
+		}
+		oom_score_adj = p->signal->oom_score_adj;
+		if (oom_score_adj < min_score_adj) {
+			task_unlock(p);
+			continue;
+		}
+		tasksize = get_mm_rss(p->mm);
+		task_unlock(p);
+		if (tasksize <= 0)
+			continue;
+		if (victim->task) {
+			if (oom_score_adj < victim->oom_score_adj)
+				continue;
+			if (oom_score_adj == victim->oom_score_adj &&
+			    tasksize <= victim->tasksize)
+				continue;
+		}
+		victim->task = p;
+		victim->tasksize = tasksize;
+		victim->oom_score_adj = oom_score_adj;
+		lowmem_print(2, "select '%s' (%d), adj %d, size %d, to kill\n",
+			     p->comm, p->pid, oom_score_adj, tasksize);
+	}
+	/* We were moved to another bucket midway, start over */
+	if (get_nulls_value(node) != b)
+		goto restart;
+
+	return 0;
+}
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct task_struct *tsk;
-	struct task_struct *selected = NULL;
+	struct task_struct *selected;
+	struct lowmem_victim victim = { NULL, 0, 0 };
 	int rem = 0;
-	int tasksize;
-	int i;
+	int i, b, limit;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
 	int minfree = 0;
-	int selected_tasksize = 0;
+	int selected_tasksize;
 	int selected_oom_score_adj;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages;
@@ -105,48 +287,32 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_score_adj = min_score_adj;
+	if (!ACCESS_ONCE(lowmem_adj_ready))
+		return rem;
+	smp_rmb();
 
 	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+	if (lowmem_death_pending()) {
+		rcu_read_unlock();
+		return 0;
+	}
 
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
+	/* Walk the non-empty buckets down from the highest oom_score_adj */
+	limit = LOWMEM_ADJ_BUCKETS;
+	while (!victim.task) {
+		b = find_last_bit(lowmem_adj_used, limit);
+		if (b >= limit || b < lowmem_adj_to_bucket(min_score_adj))
+			break;
+		if (lowmem_scan_bucket(b, min_score_adj, &victim)) {
 			rcu_read_unlock();
 			return 0;
 		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select '%s' (%d), adj %d, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
+		limit = b;
 	}
+	selected = victim.task;
+	selected_tasksize = victim.tasksize;
+	selected_oom_score_adj = victim.oom_score_adj;
+
 	if (selected) {
 		lowmem_print(1, "Killing '%s' (%d), adj %d,\n" \
 				"   to free %ldkB on behalf of '%s' (%d) because\n" \
@@ -160,7 +326,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     minfree * (long)(PAGE_SIZE / 1024),
 			     min_score_adj,
 			     other_free * (long)(PAGE_SIZE / 1024));
-		lowmem_deathpending_timeout = jiffies + HZ;
+		lowmem_set_death_pending(selected);
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		rem -= selected_tasksize;
@@ -0,0 +1,238 @@
+/*
+ * Compression stream management for zram
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zcomp.h"
+#include "zcomp_lzo.h"
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+#include "zcomp_lz4.h"
+#endif
+
+static struct zcomp_backend *backends[] = {
+	&zcomp_lzo,
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+	&zcomp_lz4,
+#endif
+	NULL
+};
+
+static struct zcomp_backend *find_backend(const char *compress)
+{
+	int i;
+
+	for (i = 0; backends[i]; i++) {
+		if (sysfs_streq(compress, backends[i]->name))
+			return backends[i];
+	}
+	return NULL;
+}
+
+static void zcomp_strm_free(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	if (zstrm->private)
+		comp->backend->destroy(zstrm->private);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+/*
+ * Allocate a new stream. The buffer is two pages long because the
+ * compressor may expand incompressible input beyond PAGE_SIZE.
+ */
+static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp, gfp_t flags)
+{
+	struct zcomp_strm *zstrm;
+
+	zstrm = kmalloc(sizeof(*zstrm), flags);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->private = comp->backend->create(flags);
+	zstrm->buffer = (void *)__get_free_pages(flags | __GFP_ZERO, 1);
+	if (!zstrm->private || !zstrm->buffer) {
+		zcomp_strm_free(comp, zstrm);
+		zstrm = NULL;
+	}
+	return zstrm;
+}
+
+/*
+ * Get an idle stream, allocating a new one if the limit allows it.
+ * Otherwise sleep until another writer releases its stream. At least
+ * one stream always exists, so the caller is guaranteed to make progress.
+ */
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	while (1) {
+		spin_lock(&comp->strm_lock);
+		if (!list_empty(&comp->idle_strm)) {
+			zstrm = list_entry(comp->idle_strm.next,
+					struct zcomp_strm, list);
+			list_del(&zstrm->list);
+			spin_unlock(&comp->strm_lock);
+			return zstrm;
+		}
+
+		if (comp->avail_strm >= comp->max_strm) {
+			spin_unlock(&comp->strm_lock);
+			wait_event(comp->strm_wait,
+				!list_empty(&comp->idle_strm));
+			continue;
+		}
+
+		comp->avail_strm++;
+		spin_unlock(&comp->strm_lock);
+
+		zstrm = zcomp_strm_alloc(comp, GFP_NOIO);
+		if (zstrm)
+			return zstrm;
+
+		/* Out of memory: fall back to waiting for a busy stream */
+		spin_lock(&comp->strm_lock);
+		comp->avail_strm--;
+		spin_unlock(&comp->strm_lock);
+		wait_event(comp->strm_wait, !list_empty(&comp->idle_strm));
+	}
+}
+
+/* Return a stream to the idle list, or free it if over the limit */
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	spin_lock(&comp->strm_lock);
+	if (comp->avail_strm <= comp->max_strm) {
+		list_add(&zstrm->list, &comp->idle_strm);
+		spin_unlock(&comp->strm_lock);
+		wake_up(&comp->strm_wait);
+		return;
+	}
+
+	comp->avail_strm--;
+	spin_unlock(&comp->strm_lock);
+	zcomp_strm_free(comp, zstrm);
+}
+
+int zcomp_set_max_streams(struct zcomp *comp, int num_strm)
+{
+	struct zcomp_strm *zstrm;
+
+	if (num_strm < 1)
+		return -EINVAL;
+
+	spin_lock(&comp->strm_lock);
+	comp->max_strm = num_strm;
+	/*
+	 * Free idle streams above the new limit. Busy ones are
+	 * freed by zcomp_strm_release() once their writers finish.
+	 */
+	while (comp->avail_strm > num_strm && !list_empty(&comp->idle_strm)) {
+		zstrm = list_entry(comp->idle_strm.next,
+				struct zcomp_strm, list);
+		list_del(&zstrm->list);
+		zcomp_strm_free(comp, zstrm);
+		comp->avail_strm--;
+	}
+	spin_unlock(&comp->strm_lock);
+
+	return 0;
+}
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len)
+{
+	return comp->backend->compress(src, zstrm->buffer, dst_len,
+			zstrm->private);
+}
+
+int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst)
+{
+	return comp->backend->decompress(src, src_len, dst);
+}
+
+/* show available compressors, the selected one in brackets */
+ssize_t zcomp_available_show(const char *comp, char *buf)
+{
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; backends[i]; i++) {
+		if (sysfs_streq(comp, backends[i]->name))
+			sz += sprintf(buf + sz, "[%s] ", backends[i]->name);
+		else
+			sz += sprintf(buf + sz, "%s ", backends[i]->name);
+	}
+	sz += sprintf(buf + sz, "\n");
+	return sz;
+}
+
+bool zcomp_available_algorithm(const char *comp)
+{
+	return find_backend(comp) != NULL;
+}
+
+void zcomp_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	while (!list_empty(&comp->idle_strm)) {
+		zstrm = list_entry(comp->idle_strm.next,
+				struct zcomp_strm, list);
+		list_del(&zstrm->list);
+		zcomp_strm_free(comp, zstrm);
+	}
+	kfree(comp);
+}
+
+/*
+ * Create a stream pool using the compression backend named by 'compress'.
+ * Returns NULL if the backend is unknown or memory allocation fails.
+ */
+struct zcomp *zcomp_create(const char *compress, int max_strm)
+{
+	struct zcomp *comp;
+	struct zcomp_strm *zstrm;
+	struct zcomp_backend *backend;
+
+	backend = find_backend(compress);
+	if (!backend)
+		return NULL;
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return NULL;
+
+	comp->backend = backend;
+	spin_lock_init(&comp->strm_lock);
+	INIT_LIST_HEAD(&comp->idle_strm);
+	init_waitqueue_head(&comp->strm_wait);
+	comp->max_strm = max_strm;
+
+	/* One stream is always available so writers can't deadlock */
+	zstrm = zcomp_strm_alloc(comp, GFP_KERNEL);
+	if (!zstrm) {
+		kfree(comp);
+		return NULL;
+	}
+	list_add(&zstrm->list, &comp->idle_strm);
+	comp->avail_strm = 1;
+
+	return comp;
+}
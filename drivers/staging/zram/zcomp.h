@@ -0,0 +1,74 @@
+/*
+ * Compression stream management for zram
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZCOMP_H_
+#define _ZCOMP_H_
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+struct zcomp_strm {
+	/* compression/decompression buffer */
+	void *buffer;
+	/* compressor working memory */
+	void *private;
+	/* used in the idle stream list */
+	struct list_head list;
+};
+
+/* static compression backend */
+struct zcomp_backend {
+	int (*compress)(const unsigned char *src, unsigned char *dst,
+			size_t *dst_len, void *private);
+
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst);
+
+	void *(*create)(gfp_t flags);
+	void (*destroy)(void *private);
+
+	const char *name;
+};
+
+/*
+ * A pool of compression streams. Each stream owns its own buffer and
+ * working memory, so up to max_strm pages can be compressed in parallel.
+ * Streams are allocated on demand and kept on idle_strm once released.
+ */
+struct zcomp {
+	spinlock_t strm_lock;		/* protects the fields below */
+	struct list_head idle_strm;
+	wait_queue_head_t strm_wait;
+	int avail_strm;			/* no. of allocated streams */
+	int max_strm;			/* upper limit on avail_strm */
+
+	struct zcomp_backend *backend;
+};
+
+ssize_t zcomp_available_show(const char *comp, char *buf);
+bool zcomp_available_algorithm(const char *comp);
+
+struct zcomp *zcomp_create(const char *comp, int max_strm);
+void zcomp_destroy(struct zcomp *comp);
+
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len);
+int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst);
+
+int zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+
+#endif /* _ZCOMP_H_ */
@@ -29,9 +29,9 @@
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
@@ -39,6 +39,8 @@
 static int zram_major;
 struct zram *zram_devices;
 
+static const char *default_compressor = "lzo";
+
 /* Module params (documentation at end) */
 static unsigned int num_devices;
 
@@ -89,25 +91,93 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check if the page consists of a single repeated word. If so, the
+ * word is returned in *element and no compressed object is needed.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (val != page[pos])
 			return 0;
 	}
 
+	*element = val;
 	return 1;
 }
 
+static void zram_fill_page(char *ptr, unsigned int len,
+			   unsigned long value)
+{
+	unsigned int pos;
+	unsigned long *page;
+
+	if (likely(value == 0)) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	page = (unsigned long *)ptr;
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+static bool zram_alloc_block(struct zram *zram, unsigned long *blk)
+{
+	spin_lock(&zram->bitmap_lock);
+	*blk = find_first_zero_bit(zram->bitmap, zram->nr_blocks);
+	if (*blk >= zram->nr_blocks) {
+		spin_unlock(&zram->bitmap_lock);
+		return false;
+	}
+	set_bit(*blk, zram->bitmap);
+	spin_unlock(&zram->bitmap_lock);
+
+	return true;
+}
+
+static void zram_free_block(struct zram *zram, unsigned long blk)
+{
+	spin_lock(&zram->bitmap_lock);
+	clear_bit(blk, zram->bitmap);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+/* zram->tb_lock should be held for writing */
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
 
+	/*
+	 * Clearing ZRAM_UNDER_WB tells a concurrent zram_writeback()
+	 * that this page has changed under it.
+	 */
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_free_block(zram, zram->table[index].element);
+		zram->table[index].element = 0;
+		zram_stat_dec(&zram->stats.pages_wb);
+		return;
+	}
+
+	/* Same filled pages keep their value in the table entry itself */
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram->table[index].element = 0;
+		zram_stat_dec(&zram->stats.pages_same);
+		return;
+	}
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -141,13 +211,13 @@ out:
 	zram->table[index].size = 0;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -169,6 +239,108 @@ static void handle_uncompressed_page(struct zram *zram, struct bio_vec *bvec,
 	flush_dcache_page(page);
 }
 
+static void zram_bdev_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/* Synchronously read or write one page at block 'blk' of the backing device */
+static int zram_bdev_rw(struct zram *zram, struct page *page,
+			unsigned long blk, int rw)
+{
+	int ret;
+	struct bio *bio;
+	DECLARE_COMPLETION_ONSTACK(done);
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+	bio->bi_end_io = zram_bdev_end_io;
+	bio->bi_private = &done;
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+
+	ret = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	if (rw == READ)
+		zram_stat64_inc(zram, &zram->stats.bd_reads);
+	else
+		zram_stat64_inc(zram, &zram->stats.bd_writes);
+
+	return ret;
+}
+
+struct zram_bdev_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk;
+	int ret;
+};
+
+static void zram_bdev_read_work(struct work_struct *work)
+{
+	struct zram_bdev_work *w =
+		container_of(work, struct zram_bdev_work, work);
+
+	w->ret = zram_bdev_rw(w->zram, w->page, w->blk, READ);
+}
+
+/*
+ * Inside zram_make_request() generic_make_request() only queues bios on
+ * current->bio_list and dispatches them after we return, so waiting for
+ * a read there would deadlock. Issue it from a worker instead.
+ */
+static int zram_bdev_read(struct zram *zram, struct page *page,
+			  unsigned long blk)
+{
+	struct zram_bdev_work w;
+
+	if (!current->bio_list)
+		return zram_bdev_rw(zram, page, blk, READ);
+
+	w.zram = zram;
+	w.page = page;
+	w.blk = blk;
+	INIT_WORK_ONSTACK(&w.work, zram_bdev_read_work);
+	queue_work(system_unbound_wq, &w.work);
+	flush_work(&w.work);
+	destroy_work_on_stack(&w.work);
+
+	return w.ret;
+}
+
+/* Read a page from the backing device into a kernel buffer */
+static int zram_bdev_read_mem(struct zram *zram, char *mem, unsigned long blk)
+{
+	int ret;
+	struct page *page;
+	unsigned char *src;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_read(zram, page, blk);
+	if (!ret) {
+		src = kmap_atomic(page);
+		memcpy(mem, src, PAGE_SIZE);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
 static inline int is_partial_io(struct bio_vec *bvec)
 {
 	return bvec->bv_len != PAGE_SIZE;
@@ -177,103 +349,133 @@ static inline int is_partial_io(struct bio_vec *bvec)
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
-	int ret;
-	size_t clen;
+	int ret = 0;
 	struct page *page;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
 
 	page = bvec->bv_page;
 
+	if (is_partial_io(bvec)) {
+		/* Use  a temporary buffer to decompress the page */
+		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+		if (!uncmem) {
+			pr_info("Error allocating temp memory!\n");
+			return -ENOMEM;
+		}
+	}
+
+	read_lock(&zram->tb_lock);
+
+	/* Page was written back, read it from the backing device */
+	if (unlikely(zram_test_flag(zram, index, ZRAM_WB))) {
+		unsigned long blk = zram->table[index].element;
+
+		read_unlock(&zram->tb_lock);
+		if (!is_partial_io(bvec)) {
+			ret = zram_bdev_read(zram, page, blk);
+		} else {
+			ret = zram_bdev_read_mem(zram, uncmem, blk);
+			if (!ret) {
+				user_mem = kmap_atomic(page);
+				memcpy(user_mem + bvec->bv_offset,
+				       uncmem + offset, bvec->bv_len);
+				kunmap_atomic(user_mem);
+				flush_dcache_page(page);
+			}
+		}
+		kfree(uncmem);
+		if (ret)
+			zram_stat64_inc(zram, &zram->stats.failed_reads);
+		return ret;
+	}
+
 	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
-		return 0;
+		handle_same_page(bvec, 0);
+		goto out;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		handle_same_page(bvec, zram->table[index].element);
+		goto out;
 	}
 
 	/* Requested page is not present in compressed area */
 	if (unlikely(!zram->table[index].handle)) {
 		pr_debug("Read before write: sector=%lu, size=%u",
 			 (ulong)(bio->bi_sector), bio->bi_size);
-		handle_zero_page(bvec);
-		return 0;
+		handle_same_page(bvec, 0);
+		goto out;
 	}
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		handle_uncompressed_page(zram, bvec, index, offset);
-		return 0;
-	}
-
-	if (is_partial_io(bvec)) {
-		/* Use  a temporary buffer to decompress the page */
-		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
-		if (!uncmem) {
-			pr_info("Error allocating temp memory!\n");
-			return -ENOMEM;
-		}
+		goto out;
 	}
 
 	user_mem = kmap_atomic(page);
-	if (!is_partial_io(bvec))
-		uncmem = user_mem;
-	clen = PAGE_SIZE;
-
 	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zcomp_decompress(zram->comp, cmem + sizeof(*zheader),
+			       zram->table[index].size,
+			       is_partial_io(bvec) ? uncmem : user_mem);
 
-	if (is_partial_io(bvec)) {
+	if (is_partial_io(bvec))
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
 		       bvec->bv_len);
-		kfree(uncmem);
-	}
 
 	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
 	kunmap_atomic(user_mem);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
-		return ret;
+		goto out;
 	}
 
 	flush_dcache_page(page);
 
-	return 0;
+out:
+	read_unlock(&zram->tb_lock);
+	kfree(uncmem);
+	return ret;
 }
 
+/* zram->tb_lock should be held */
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
 	struct zobj_header *zheader;
 	unsigned char *cmem;
+	void *handle = zram->table[index].handle;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
-	    !zram->table[index].handle) {
-		memset(mem, 0, PAGE_SIZE);
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, zram->table[index].element);
 		return 0;
 	}
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	if (zram_test_flag(zram, index, ZRAM_ZERO) || !handle) {
+		memset(mem, 0, PAGE_SIZE);
+		return 0;
+	}
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(handle);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+	cmem = zs_map_object(zram->mem_pool, handle);
+	ret = zcomp_decompress(zram->comp, cmem + sizeof(*zheader),
+			       zram->table[index].size, mem);
+	zs_unmap_object(zram->mem_pool, handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -282,126 +484,153 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/* Like zram_read_before_write(), but also handles written back pages */
+static int zram_read_page(struct zram *zram, char *mem, u32 index)
+{
+	int ret;
+
+	read_lock(&zram->tb_lock);
+	if (unlikely(zram_test_flag(zram, index, ZRAM_WB))) {
+		unsigned long blk = zram->table[index].element;
+
+		read_unlock(&zram->tb_lock);
+		return zram_bdev_read_mem(zram, mem, blk);
+	}
+	ret = zram_read_before_write(zram, mem, index);
+	read_unlock(&zram->tb_lock);
+
+	return ret;
+}
+
+/*
+ * Compression runs on a private stream outside of tb_lock, so writes
+ * to different pages are compressed in parallel on all CPUs. The table
+ * lock is only taken to read the old contents of a partially written
+ * page and to publish the new handle.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
-	int ret;
-	u32 store_offset;
+	int ret = 0;
 	size_t clen;
 	void *handle;
+	unsigned long element;
+	bool incompressible = false;
 	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
 		 * This is a partial IO. We need to read the full page
 		 * before to write the changes.
 		 */
-		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
 		if (!uncmem) {
 			pr_info("Error allocating temp memory!\n");
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_read_before_write(zram, uncmem, index);
-		if (ret) {
-			kfree(uncmem);
+		ret = zram_read_page(zram, uncmem, index);
+		if (ret)
 			goto out;
-		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
+	zstrm = zcomp_strm_find(zram->comp);
+	src = zstrm->buffer;
 
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec))
 		memcpy(uncmem + offset, user_mem + bvec->bv_offset,
 		       bvec->bv_len);
-	else
-		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(is_partial_io(bvec) ? uncmem : user_mem,
+			     &element)) {
 		kunmap_atomic(user_mem);
-		if (is_partial_io(bvec))
-			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
-		ret = 0;
-		goto out;
-	}
+		zcomp_strm_release(zram->comp, zstrm);
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
-
-	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-			kfree(uncmem);
-
-	if (unlikely(ret != LZO_E_OK)) {
-		pr_err("Compression failed! err=%d\n", ret);
+		write_lock(&zram->tb_lock);
+		/*
+		 * System overwrites unused sectors. Free memory associated
+		 * with this sector now.
+		 */
+		zram_free_page(zram, index);
+		if (!element) {
+			zram_stat_inc(&zram->stats.pages_zero);
+			zram_set_flag(zram, index, ZRAM_ZERO);
+		} else {
+			zram_stat_inc(&zram->stats.pages_same);
+			zram_set_flag(zram, index, ZRAM_SAME);
+			zram->table[index].element = element;
+		}
+		write_unlock(&zram->tb_lock);
 		goto out;
 	}
 
+	ret = zcomp_compress(zram->comp, zstrm,
+			     is_partial_io(bvec) ? uncmem : user_mem, &clen);
+
 	/*
 	 * Page is incompressible. Store it as-is (uncompressed)
 	 * since we do not want to return too many disk write
 	 * errors which has side effect of hanging the system.
 	 */
-	if (unlikely(clen > max_zpage_size)) {
+	if (!ret && unlikely(clen > max_zpage_size)) {
+		incompressible = true;
 		clen = PAGE_SIZE;
+		memcpy(src, is_partial_io(bvec) ? uncmem : user_mem, clen);
+	}
+
+	kunmap_atomic(user_mem);
+
+	if (unlikely(ret)) {
+		pr_err("Compression failed! err=%d\n", ret);
+		goto out_release;
+	}
+
+	if (unlikely(incompressible)) {
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
 			pr_info("Error allocating memory for "
 				"incompressible page: %u\n", index);
 			ret = -ENOMEM;
-			goto out;
+			goto out_release;
 		}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
 		handle = page_store;
-		src = kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
-		goto memstore;
-	}
+		memcpy(cmem, src, clen);
+		kunmap_atomic(cmem);
+	} else {
+		handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
+		if (!handle) {
+			pr_info("Error allocating memory for compressed "
+				"page: %u, size=%zu\n", index, clen);
+			ret = -ENOMEM;
+			goto out_release;
+		}
 
-	handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
-	if (!handle) {
-		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
-		ret = -ENOMEM;
-		goto out;
+		cmem = zs_map_object(zram->mem_pool, handle);
+		memcpy(cmem, src, clen);
+		zs_unmap_object(zram->mem_pool, handle);
 	}
-	cmem = zs_map_object(zram->mem_pool, handle);
 
-memstore:
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
-#endif
+	zcomp_strm_release(zram->comp, zstrm);
 
-	memcpy(cmem, src, clen);
+	write_lock(&zram->tb_lock);
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	zram_free_page(zram, index);
 
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		kunmap_atomic(cmem);
-		kunmap_atomic(src);
-	} else {
-		zs_unmap_object(zram->mem_pool, handle);
+	if (unlikely(incompressible)) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat_inc(&zram->stats.pages_expand);
 	}
 
 	zram->table[index].handle = handle;
@@ -412,33 +641,158 @@ memstore:
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
+	write_unlock(&zram->tb_lock);
 
-	return 0;
+	goto out;
 
+out_release:
+	zcomp_strm_release(zram->comp, zstrm);
 out:
+	kfree(uncmem);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
 }
 
+/* Forget the idle mark of a page that was just read */
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	if (likely(!zram_test_flag(zram, index, ZRAM_IDLE)))
+		return;
+
+	write_lock(&zram->tb_lock);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	write_unlock(&zram->tb_lock);
+}
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
 	int ret;
 
 	if (rw == READ) {
-		down_read(&zram->lock);
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
-	} else {
-		down_write(&zram->lock);
-		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
+		zram_accessed(zram, index);
+		return ret;
+	}
+
+	return zram_bvec_write(zram, bvec, index, offset);
+}
+
+/* zram->init_lock should be held */
+void zram_mark_idle(struct zram *zram)
+{
+	size_t index;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		write_lock(&zram->tb_lock);
+		if (zram->table[index].handle &&
+		    !zram_test_flag(zram, index, ZRAM_SAME) &&
+		    !zram_test_flag(zram, index, ZRAM_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		write_unlock(&zram->tb_lock);
 	}
+}
+
+/* zram->tb_lock should be held */
+static bool zram_wb_candidate(struct zram *zram, u32 index, int mode)
+{
+	if (!zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		return false;
+
+	if ((mode & ZRAM_WB_HUGE) &&
+	    zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))
+		return true;
+
+	if ((mode & ZRAM_WB_IDLE) && zram_test_flag(zram, index, ZRAM_IDLE))
+		return true;
+
+	return false;
+}
+
+static void zram_clear_under_wb(struct zram *zram, u32 index)
+{
+	write_lock(&zram->tb_lock);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	write_unlock(&zram->tb_lock);
+}
 
+/*
+ * Move pages selected by 'mode' to the backing device and free the
+ * memory they used. A page that is freed or rewritten while its copy is
+ * in flight loses ZRAM_UNDER_WB, and the copy is then dropped.
+ *
+ * zram->init_lock should be held
+ */
+int zram_writeback(struct zram *zram, int mode)
+{
+	int ret = 0;
+	size_t index;
+	unsigned long blk;
+	struct page *page;
+
+	if (!zram->bdev)
+		return -ENODEV;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		write_lock(&zram->tb_lock);
+		if (!zram_wb_candidate(zram, index, mode)) {
+			write_unlock(&zram->tb_lock);
+			continue;
+		}
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		write_unlock(&zram->tb_lock);
+
+		if (!zram_alloc_block(zram, &blk)) {
+			zram_clear_under_wb(zram, index);
+			ret = -ENOSPC;
+			break;
+		}
+
+		ret = zram_read_page(zram, page_address(page), index);
+		if (!ret)
+			ret = zram_bdev_rw(zram, page, blk, WRITE);
+		if (ret) {
+			zram_free_block(zram, blk);
+			zram_clear_under_wb(zram, index);
+			break;
+		}
+
+		write_lock(&zram->tb_lock);
+		if (!zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+			write_unlock(&zram->tb_lock);
+			zram_free_block(zram, blk);
+			continue;
+		}
+		zram_free_page(zram, index);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram->table[index].element = blk;
+		zram_stat_inc(&zram->stats.pages_wb);
+		write_unlock(&zram->tb_lock);
+
+		cond_resched();
+	}
+
+	__free_page(page);
 	return ret;
 }
 
+/* zram->init_lock should be held */
+void zram_compact(struct zram *zram)
+{
+	unsigned long freed;
+
+	freed = zs_compact(zram->mem_pool);
+	zram_stat64_add(zram, &zram->stats.pages_compacted, freed);
+}
+
 static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 {
 	if (*offset + bvec->bv_len >= PAGE_SIZE)
@@ -544,26 +898,89 @@ error:
 	bio_io_error(bio);
 }
 
+static void zram_reset_backing_dev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	vfree(zram->bitmap);
+
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	zram->bitmap = NULL;
+	zram->nr_blocks = 0;
+}
+
+/* zram->init_lock should be held and the device not yet initialized */
+int zram_set_backing_dev(struct zram *zram, const char *path)
+{
+	int err;
+	struct file *file;
+	struct inode *inode;
+	struct block_device *bdev;
+	unsigned long nr_blocks, *bitmap;
+
+	file = filp_open(path, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	inode = file->f_mapping->host;
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0)
+		goto out;
+
+	nr_blocks = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!bitmap) {
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+		err = -ENOMEM;
+		goto out;
+	}
+
+	zram_reset_backing_dev(zram);
+	zram->backing_dev = file;
+	zram->bdev = bdev;
+	zram->nr_blocks = nr_blocks;
+	zram->bitmap = bitmap;
+
+	pr_info("setup backing device %s\n", path);
+	return 0;
+
+out:
+	filp_close(file, NULL);
+	return err;
+}
+
 void __zram_reset_device(struct zram *zram)
 {
 	size_t index;
 
+	zram_reset_backing_dev(zram);
+
 	if (!zram->init_done)
 		return;
 
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	if (zram->comp) {
+		zcomp_destroy(zram->comp);
+		zram->comp = NULL;
+	}
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		void *handle = zram->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
@@ -612,17 +1029,9 @@ int zram_init_device(struct zram *zram)
 		);
 	}
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
+	zram->comp = zcomp_create(zram->compressor, zram->max_comp_streams);
+	if (!zram->comp) {
+		pr_err("Error allocating compression streams!\n");
 		ret = -ENOMEM;
 		goto fail_no_table;
 	}
@@ -638,7 +1047,8 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
@@ -665,7 +1075,9 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
+	write_lock(&zram->tb_lock);
 	zram_free_page(zram, index);
+	write_unlock(&zram->tb_lock);
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -678,9 +1090,13 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
 
-	init_rwsem(&zram->lock);
+	rwlock_init(&zram->tb_lock);
+	spin_lock_init(&zram->bitmap_lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	zram->max_comp_streams = num_online_cpus();
+	strlcpy(zram->compressor, default_compressor,
+		sizeof(zram->compressor));
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -19,6 +19,7 @@
 #include <linux/mutex.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -71,6 +72,18 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* Page is filled with one repeated non-zero word */
+	ZRAM_SAME,
+
+	/* Page is stored on the backing device */
+	ZRAM_WB,
+
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+
+	/* Page was not accessed since it was last marked idle */
+	ZRAM_IDLE,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
@@ -78,7 +91,11 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	void *handle;
+	union {
+		void *handle;
+		unsigned long element;	/* value of a ZRAM_SAME page or
+					 * block index of a ZRAM_WB page */
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
@@ -93,6 +110,11 @@ struct zram_stats {
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of other same filled pages */
+	u32 pages_wb;		/* no. of pages on the backing device */
+	u64 bd_reads;		/* no. of reads from the backing device */
+	u64 bd_writes;		/* no. of writes to the backing device */
+	u64 pages_compacted;	/* pages freed by compaction */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
@@ -100,12 +122,11 @@ struct zram_stats {
 
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zcomp *comp;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	rwlock_t tb_lock;	/* protect table and 32-bit stats against
+				 * concurrent read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -116,6 +137,17 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	/* Max no. of compression streams, one per CPU by default */
+	int max_comp_streams;
+	/* Name of the compression backend, set before disksize */
+	char compressor[10];
+
+	/* Optional block device that idle/incompressible pages go to */
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned long nr_blocks;	/* size of bdev in pages */
+	unsigned long *bitmap;		/* allocated bdev blocks */
+	spinlock_t bitmap_lock;
 
 	struct zram_stats stats;
 };
@@ -126,7 +158,15 @@ unsigned int zram_get_num_devices(void);
 extern struct attribute_group zram_disk_attr_group;
 #endif
 
+/* Page selection for zram_writeback() */
+#define ZRAM_WB_HUGE	0x1	/* incompressible pages */
+#define ZRAM_WB_IDLE	0x2	/* pages marked idle and not accessed since */
+
 extern int zram_init_device(struct zram *zram);
 extern void zram_reset_device(struct zram *zram);
+extern int zram_set_backing_dev(struct zram *zram, const char *path);
+extern void zram_mark_idle(struct zram *zram);
+extern int zram_writeback(struct zram *zram, int mode);
+extern void zram_compact(struct zram *zram);
 
 #endif
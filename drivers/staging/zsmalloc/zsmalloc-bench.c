@@ -0,0 +1,153 @@
+/*
+ * zsmalloc allocation benchmark
+ *
+ * Runs 1 to max_threads kernel threads, each bound to its own CPU, that
+ * allocate and free objects in a shared pool, and logs the number of
+ * allocations per second for each thread count. Load it, read dmesg,
+ * and unload it.
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zsmalloc-bench"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include "zsmalloc.h"
+
+#define BENCH_BATCH	64
+
+static unsigned int max_threads = 4;
+module_param(max_threads, uint, 0444);
+MODULE_PARM_DESC(max_threads, "Largest number of threads to run (default 4)");
+
+static unsigned int iterations = 20000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Batches of 64 allocations per thread");
+
+static unsigned int obj_size = 512;
+module_param(obj_size, uint, 0444);
+MODULE_PARM_DESC(obj_size, "Object size in bytes (default 512)");
+
+static struct zs_pool *bench_pool;
+static DECLARE_COMPLETION(bench_start);
+static DECLARE_COMPLETION(bench_done);
+static atomic_t bench_running;
+static atomic_t bench_failed;
+
+static int bench_thread(void *unused)
+{
+	void *handles[BENCH_BATCH];
+	unsigned int i, j, n;
+
+	wait_for_completion(&bench_start);
+
+	for (i = 0; i < iterations; i++) {
+		for (n = 0; n < BENCH_BATCH; n++) {
+			handles[n] = zs_malloc(bench_pool, obj_size);
+			if (!handles[n]) {
+				atomic_inc(&bench_failed);
+				break;
+			}
+		}
+		for (j = 0; j < n; j++)
+			zs_free(bench_pool, handles[j]);
+		if (n < BENCH_BATCH)
+			break;
+		cond_resched();
+	}
+
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_done);
+	return 0;
+}
+
+static int bench_run(unsigned int nr_threads)
+{
+	struct task_struct *tsk;
+	unsigned int i, cpu;
+	ktime_t start;
+	s64 ns;
+	u64 rate;
+
+	INIT_COMPLETION(bench_start);
+	INIT_COMPLETION(bench_done);
+	atomic_set(&bench_running, nr_threads);
+	atomic_set(&bench_failed, 0);
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < nr_threads; i++) {
+		tsk = kthread_create(bench_thread, NULL, "zs_bench/%u", i);
+		if (IS_ERR(tsk)) {
+			/* Threads already created exit once started */
+			atomic_sub(nr_threads - i, &bench_running);
+			complete_all(&bench_start);
+			if (i)
+				wait_for_completion(&bench_done);
+			return PTR_ERR(tsk);
+		}
+		kthread_bind(tsk, cpu);
+		wake_up_process(tsk);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	start = ktime_get();
+	complete_all(&bench_start);
+	wait_for_completion(&bench_done);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_read(&bench_failed)) {
+		pr_err("%u threads: allocation failed\n", nr_threads);
+		return -ENOMEM;
+	}
+
+	rate = (u64)nr_threads * iterations * BENCH_BATCH * NSEC_PER_SEC;
+	rate = div64_u64(rate, max_t(u64, ns, 1));
+	pr_info("%u threads: %llu allocs/sec\n", nr_threads,
+		(unsigned long long)rate);
+	return 0;
+}
+
+static int __init zs_bench_init(void)
+{
+	unsigned int n;
+	int ret = 0;
+
+	if (!obj_size || !iterations || !max_threads)
+		return -EINVAL;
+
+	bench_pool = zs_create_pool("bench", GFP_KERNEL | __GFP_HIGHMEM);
+	if (!bench_pool)
+		return -ENOMEM;
+
+	pr_info("%u byte objects, %u online cpus\n", obj_size,
+		num_online_cpus());
+	for (n = 1; n <= max_threads && !ret; n++)
+		ret = bench_run(n);
+
+	zs_destroy_pool(bench_pool);
+	return ret;
+}
+
+static void __exit zs_bench_exit(void)
+{
+}
+
+module_init(zs_bench_init);
+module_exit(zs_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zsmalloc allocation benchmark");
@@ -17,9 +17,14 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <asm/tlbflush.h>
@@ -27,6 +32,7 @@
 #include <linux/cpumask.h>
 #include <linux/cpu.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include "zsmalloc.h"
 #include "zsmalloc_int.h"
@@ -43,6 +49,15 @@
 /* per-cpu VM mapping areas for zspage accesses that cross page boundaries */
 static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
 
+/* handles are allocated from here, one unsigned long each */
+static struct kmem_cache *zs_handle_cachep;
+
+/* all pools, so their per-cpu caches can be drained on cpu hotplug */
+static LIST_HEAD(zs_pools);
+static DEFINE_MUTEX(zs_pools_lock);
+
+static void zs_cache_drain_cpu(struct zs_pool *pool, int cpu);
+
 static int is_first_page(struct page *page)
 {
 	return test_bit(PG_private, &page->flags);
@@ -230,30 +245,70 @@ static struct page *get_next_page(struct page *page)
 	return next;
 }
 
-/* Encode <page, obj_idx> as a single handle value */
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+/* Encode <page, obj_idx> as a single obj value */
+static unsigned long location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
-		return NULL;
+		return 0;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= (obj_idx & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= (obj_idx & OBJ_INDEX_MASK);
+	obj <<= OBJ_TAG_BITS;
 
-	return (void *)handle;
+	return obj;
 }
 
-/* Decode <page, obj_idx> pair from the given object handle */
-static void obj_handle_to_location(void *handle, struct page **page,
+/* Decode <page, obj_idx> pair from the given obj value */
+static void obj_to_location(unsigned long obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	unsigned long hval = (unsigned long)handle;
+	obj >>= OBJ_TAG_BITS;
+	*page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*obj_idx = obj & OBJ_INDEX_MASK;
+}
 
-	*page = pfn_to_page(hval >> OBJ_INDEX_BITS);
-	*obj_idx = hval & OBJ_INDEX_MASK;
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return *(unsigned long *)handle & ~(1UL << HANDLE_PIN_BIT);
+}
+
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	*(unsigned long *)handle = obj;
+}
+
+/*
+ * A pinned handle's object is neither freed nor migrated, so its
+ * location stays valid until the handle is unpinned.
+ */
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static unsigned long alloc_handle(struct zs_pool *pool)
+{
+	return (unsigned long)kmem_cache_alloc(zs_handle_cachep,
+					pool->flags & ~__GFP_HIGHMEM);
+}
+
+static void free_handle(unsigned long handle)
+{
+	kmem_cache_free(zs_handle_cachep, (void *)handle);
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -330,7 +385,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
@@ -341,10 +396,16 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 * page (if present)
 		 */
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = location_to_obj(next_page, 0);
 		kunmap_atomic(link);
 		page = next_page;
-		off = (off + class->size) % PAGE_SIZE;
+		/*
+		 * If the last object straddles the page boundary, the next
+		 * page starts where it ends. Otherwise it starts at 0.
+		 */
+		if (off < PAGE_SIZE)
+			off += class->size;
+		off %= PAGE_SIZE;
 	}
 }
 
@@ -396,7 +457,7 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = (void *)location_to_obj(first_page, 0);
 	/* Maximum number of objects we can store in this zspage */
 	first_page->objects = class->zspage_order * PAGE_SIZE / class->size;
 
@@ -482,6 +543,7 @@ static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 {
 	int cpu = (long)pcpu;
 	struct mapping_area *area;
+	struct zs_pool *pool;
 
 	switch (action) {
 	case CPU_UP_PREPARE:
@@ -499,6 +561,11 @@ static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 		break;
 	case CPU_DEAD:
 	case CPU_UP_CANCELED:
+		mutex_lock(&zs_pools_lock);
+		list_for_each_entry(pool, &zs_pools, list)
+			zs_cache_drain_cpu(pool, cpu);
+		mutex_unlock(&zs_pools_lock);
+
 		area = &per_cpu(zs_map_area, cpu);
 		if (area->vm_buf)
 			free_page((unsigned long)area->vm_buf);
@@ -513,6 +580,90 @@ static struct notifier_block zs_cpu_nb = {
 	.notifier_call = zs_cpu_notifier
 };
 
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *zs_stat_root;
+
+static int zs_stats_show(struct seq_file *s, void *v)
+{
+	int i;
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	unsigned long objs_per_zspage, objs_inuse, objs_allocated;
+	unsigned long pages_used, pages_compacted;
+
+	seq_printf(s, " %5s %5s %13s %13s %10s %15s %15s\n", "class", "size",
+			"obj_allocated", "obj_used", "pages_used",
+			"pages_per_zspage", "pages_compacted");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		objs_inuse = class->objs_inuse;
+		pages_used = class->pages_allocated;
+		pages_compacted = class->pages_compacted;
+		spin_unlock(&class->lock);
+
+		objs_per_zspage = class->zspage_order * PAGE_SIZE /
+					class->size;
+		objs_allocated = pages_used / class->zspage_order *
+					objs_per_zspage;
+
+		seq_printf(s, " %5u %5u %13lu %13lu %10lu %15d %15lu\n",
+			i, class->size, objs_allocated, objs_inuse,
+			pages_used, class->zspage_order, pages_compacted);
+	}
+
+	return 0;
+}
+
+static int zs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_show, inode->i_private);
+}
+
+static const struct file_operations zs_stat_fops = {
+	.open		= zs_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (!zs_stat_root)
+		return;
+
+	/* Failure only means the stats are not visible */
+	pool->stat_dentry = debugfs_create_file(pool->name, S_IRUGO,
+				zs_stat_root, pool, &zs_stat_fops);
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove(pool->stat_dentry);
+}
+
+static void zs_stat_init(void)
+{
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+}
+
+static void zs_stat_exit(void)
+{
+	debugfs_remove_recursive(zs_stat_root);
+}
+
+#else /* CONFIG_DEBUG_FS */
+
+static inline void zs_pool_stat_create(struct zs_pool *pool) { }
+static inline void zs_pool_stat_destroy(struct zs_pool *pool) { }
+static inline void zs_stat_init(void) { }
+static inline void zs_stat_exit(void) { }
+
+#endif
+
 static void zs_exit(void)
 {
 	int cpu;
@@ -520,12 +671,22 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+
+	zs_stat_exit();
+	if (zs_handle_cachep)
+		kmem_cache_destroy(zs_handle_cachep);
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+	zs_handle_cachep = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					0, 0, NULL);
+	if (!zs_handle_cachep)
+		return -ENOMEM;
+	zs_stat_init();
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
@@ -565,18 +726,40 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 		spin_lock_init(&class->lock);
 		class->zspage_order = get_zspage_order(size);
 
+		class->cache = alloc_percpu(struct zs_cpu_cache);
+		if (!class->cache)
+			goto fail;
 	}
 
 	pool->flags = flags;
 	pool->name = name;
+	zs_pool_stat_create(pool);
+
+	mutex_lock(&zs_pools_lock);
+	list_add(&pool->list, &zs_pools);
+	mutex_unlock(&zs_pools_lock);
 
 	return pool;
+
+fail:
+	while (i--)
+		free_percpu(pool->size_class[i].cache);
+	kfree(pool);
+	return NULL;
 }
 EXPORT_SYMBOL_GPL(zs_create_pool);
 
 void zs_destroy_pool(struct zs_pool *pool)
 {
-	int i;
+	int i, cpu;
+
+	mutex_lock(&zs_pools_lock);
+	list_del(&pool->list);
+	mutex_unlock(&zs_pools_lock);
+
+	/* There are no users left, so any cpu's cache can be drained */
+	for_each_possible_cpu(cpu)
+		zs_cache_drain_cpu(pool, cpu);
 
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
@@ -589,116 +772,333 @@ void zs_destroy_pool(struct zs_pool *pool)
 					class->size, fg);
 			}
 		}
+		free_percpu(class->cache);
 	}
+	zs_pool_stat_destroy(pool);
 	kfree(pool);
 }
 EXPORT_SYMBOL_GPL(zs_destroy_pool);
 
-/**
- * zs_malloc - Allocate block of given size from pool.
- * @pool: pool to allocate from
- * @size: size of block to allocate
- * @page: page no. that holds the object
- * @offset: location of object within page
- *
- * On success, <page, offset> identifies block allocated
- * and 0 is returned. On failure, <page, offset> is set to
- * 0 and -ENOMEM is returned.
- *
- * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
- */
-void *zs_malloc(struct zs_pool *pool, size_t size)
+/* Take an object off first_page's freelist and store 'handle' in it */
+static unsigned long obj_malloc(struct size_class *class,
+				struct page *first_page, unsigned long handle)
 {
-	void *obj;
+	unsigned long obj;
 	struct link_free *link;
-	int class_idx;
-	struct size_class *class;
-
-	struct page *first_page, *m_page;
+	struct page *m_page;
 	unsigned long m_objidx, m_offset;
 
-	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
-		return NULL;
-
-	class_idx = get_size_class_index(size);
-	class = &pool->size_class[class_idx];
-	BUG_ON(class_idx != class->index);
-
-	spin_lock(&class->lock);
-	first_page = find_get_zspage(class);
-
-	if (!first_page) {
-		spin_unlock(&class->lock);
-		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
-			return NULL;
-
-		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
-		spin_lock(&class->lock);
-		class->pages_allocated += class->zspage_order;
-	}
-
-	obj = first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
+	obj = (unsigned long)first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
 	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
 
 	link = (struct link_free *)kmap_atomic(m_page) +
 					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
+	first_page->freelist = (void *)link->next;
+	link->handle = handle | OBJ_ALLOCATED_TAG;
 	kunmap_atomic(link);
 
 	first_page->inuse++;
-	/* Now move the zspage to another fullness group, if required */
-	fix_fullness_group(pool, first_page);
-	spin_unlock(&class->lock);
+	class->objs_inuse++;
 
 	return obj;
 }
-EXPORT_SYMBOL_GPL(zs_malloc);
 
-void zs_free(struct zs_pool *pool, void *obj)
+/* Put an object back on its zspage's freelist */
+static void obj_free(struct size_class *class, unsigned long obj)
 {
 	struct link_free *link;
 	struct page *first_page, *f_page;
 	unsigned long f_objidx, f_offset;
 
-	int class_idx;
-	struct size_class *class;
-	enum fullness_group fullness;
-
-	if (unlikely(!obj))
-		return;
-
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	obj_to_location(obj, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
-
-	get_zspage_mapping(first_page, &class_idx, &fullness);
-	class = &pool->size_class[class_idx];
 	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
-	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
 	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
 							+ f_offset);
-	link->next = first_page->freelist;
+	link->next = (unsigned long)first_page->freelist;
 	kunmap_atomic(link);
-	first_page->freelist = obj;
+	first_page->freelist = (void *)obj;
 
 	first_page->inuse--;
-	fullness = fix_fullness_group(pool, first_page);
+	class->objs_inuse--;
+}
 
-	if (fullness == ZS_EMPTY)
-		class->pages_allocated -= class->zspage_order;
+static struct size_class *handle_to_class(struct zs_pool *pool,
+				unsigned long handle)
+{
+	struct page *page;
+	unsigned long obj_idx;
+	unsigned int class_idx;
+	enum fullness_group fg;
 
+	/* Keep compaction from moving the object while we look at it */
+	pin_tag(handle);
+	obj_to_location(handle_to_obj(handle), &page, &obj_idx);
+	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
+	unpin_tag(handle);
+
+	return &pool->size_class[class_idx];
+}
+
+/*
+ * Free a batch of objects of one class under a single class->lock.
+ * None of the handles may be mapped.
+ */
+static void zs_free_batch(struct zs_pool *pool, struct size_class *class,
+				unsigned long *handles, int nr)
+{
+	struct page *empty[ZS_CPU_CACHE_SIZE + 1];
+	struct page *page, *first_page;
+	unsigned long obj, obj_idx;
+	int i, nr_empty = 0;
+
+	BUG_ON(nr > ARRAY_SIZE(empty));
+
+	spin_lock(&class->lock);
+	for (i = 0; i < nr; i++) {
+		obj = handle_to_obj(handles[i]);
+		obj_to_location(obj, &page, &obj_idx);
+		first_page = get_first_page(page);
+
+		obj_free(class, obj);
+		if (fix_fullness_group(pool, first_page) == ZS_EMPTY) {
+			class->pages_allocated -= class->zspage_order;
+			empty[nr_empty++] = first_page;
+		}
+	}
 	spin_unlock(&class->lock);
 
-	if (fullness == ZS_EMPTY)
-		free_zspage(first_page);
+	for (i = 0; i < nr; i++)
+		free_handle(handles[i]);
+	for (i = 0; i < nr_empty; i++)
+		free_zspage(empty[i]);
+}
+
+/*
+ * Stash objects in this CPU's cache. Whatever doesn't fit, say because
+ * we were migrated to a CPU whose cache is already full, is freed.
+ */
+static void zs_cache_fill(struct zs_pool *pool, struct size_class *class,
+				unsigned long *handles, int nr)
+{
+	struct zs_cpu_cache *cache;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(class->cache);
+	while (nr && cache->count < ZS_CPU_CACHE_SIZE)
+		cache->handles[cache->count++] = handles[--nr];
+	local_irq_restore(flags);
+
+	if (nr)
+		zs_free_batch(pool, class, handles, nr);
+}
+
+/*
+ * Give all objects cached on 'cpu' back to their zspages. Must run
+ * on that cpu, or after it went offline.
+ */
+static void zs_cache_drain_cpu(struct zs_pool *pool, int cpu)
+{
+	unsigned long handles[ZS_CPU_CACHE_SIZE];
+	struct zs_cpu_cache *cache;
+	unsigned long flags;
+	int i, nr;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		local_irq_save(flags);
+		cache = per_cpu_ptr(class->cache, cpu);
+		nr = cache->count;
+		memcpy(handles, cache->handles, nr * sizeof(handles[0]));
+		cache->count = 0;
+		local_irq_restore(flags);
+
+		if (nr)
+			zs_free_batch(pool, class, handles, nr);
+	}
+}
+
+struct zs_drain_work {
+	struct work_struct work;
+	struct zs_pool *pool;
+	int cpu;
+};
+
+static void zs_cache_drain_work(struct work_struct *work)
+{
+	struct zs_drain_work *dw = container_of(work, struct zs_drain_work,
+						work);
+
+	zs_cache_drain_cpu(dw->pool, dw->cpu);
+}
+
+/*
+ * Drain the caches of all online CPUs, each one from its own CPU.
+ * Offline CPUs were drained by the hotplug notifier. Best effort:
+ * objects cached after we pass a CPU stay there.
+ */
+static void zs_cache_drain_all(struct zs_pool *pool)
+{
+	struct zs_drain_work __percpu *works;
+	int cpu;
+
+	works = alloc_percpu(struct zs_drain_work);
+	if (!works)
+		return;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		struct zs_drain_work *dw = per_cpu_ptr(works, cpu);
+
+		INIT_WORK(&dw->work, zs_cache_drain_work);
+		dw->pool = pool;
+		dw->cpu = cpu;
+		schedule_work_on(cpu, &dw->work);
+	}
+	for_each_online_cpu(cpu)
+		flush_work(&per_cpu_ptr(works, cpu)->work);
+	put_online_cpus();
+
+	free_percpu(works);
+}
+
+/*
+ * Allocate an object under class->lock, along with up to
+ * ZS_CPU_CACHE_BATCH - 1 more from the same zspages for this CPU's cache.
+ * The pool is only grown for the first one.
+ */
+static unsigned long zs_malloc_slow(struct zs_pool *pool,
+				struct size_class *class)
+{
+	unsigned long handles[ZS_CPU_CACHE_BATCH];
+	struct page *first_page;
+	unsigned long obj;
+	int i, nr;
+
+	for (nr = 0; nr < ZS_CPU_CACHE_BATCH; nr++) {
+		handles[nr] = alloc_handle(pool);
+		if (!handles[nr])
+			break;
+	}
+	if (!nr)
+		return 0;
+
+	spin_lock(&class->lock);
+	for (i = 0; i < nr; i++) {
+		first_page = find_get_zspage(class);
+		if (!first_page) {
+			if (i)
+				break;
+
+			spin_unlock(&class->lock);
+			first_page = alloc_zspage(class, pool->flags);
+			if (unlikely(!first_page)) {
+				while (nr--)
+					free_handle(handles[nr]);
+				return 0;
+			}
+
+			set_zspage_mapping(first_page, class->index, ZS_EMPTY);
+			spin_lock(&class->lock);
+			class->pages_allocated += class->zspage_order;
+		}
+
+		obj = obj_malloc(class, first_page, handles[i]);
+		/* Now move the zspage to another fullness group, if required */
+		fix_fullness_group(pool, first_page);
+		record_obj(handles[i], obj);
+	}
+	spin_unlock(&class->lock);
+
+	while (nr > i)
+		free_handle(handles[--nr]);
+	if (nr > 1)
+		zs_cache_fill(pool, class, handles + 1, nr - 1);
+
+	return handles[0];
+}
+
+/**
+ * zs_malloc - Allocate block of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of block to allocate
+ *
+ * On success, handle to the allocated object is returned,
+ * otherwise NULL.
+ *
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE
+ * will fail.
+ */
+void *zs_malloc(struct zs_pool *pool, size_t size)
+{
+	unsigned long handle = 0;
+	int class_idx;
+	struct size_class *class;
+	struct zs_cpu_cache *cache;
+	unsigned long flags;
+
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return NULL;
+
+	/* extra space in chunk to keep the handle */
+	size += ZS_HANDLE_SIZE;
+	class_idx = get_size_class_index(size);
+	class = &pool->size_class[class_idx];
+	BUG_ON(class_idx != class->index);
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(class->cache);
+	if (likely(cache->count))
+		handle = cache->handles[--cache->count];
+	local_irq_restore(flags);
+
+	if (unlikely(!handle))
+		handle = zs_malloc_slow(pool, class);
+
+	return (void *)handle;
+}
+EXPORT_SYMBOL_GPL(zs_malloc);
+
+void zs_free(struct zs_pool *pool, void *obj)
+{
+	unsigned long handle = (unsigned long)obj;
+	unsigned long handles[ZS_CPU_CACHE_BATCH];
+	struct size_class *class;
+	struct zs_cpu_cache *cache;
+	unsigned long flags;
+	int nr = 0;
+
+	if (unlikely(!handle))
+		return;
+
+	class = handle_to_class(pool, handle);
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(class->cache);
+	if (unlikely(cache->count == ZS_CPU_CACHE_SIZE)) {
+		/* Make room by giving the oldest objects back */
+		nr = ZS_CPU_CACHE_BATCH;
+		memcpy(handles, cache->handles, sizeof(handles));
+		memmove(cache->handles, cache->handles + nr,
+			(ZS_CPU_CACHE_SIZE - nr) * sizeof(handles[0]));
+		cache->count -= nr;
+	}
+	cache->handles[cache->count++] = handle;
+	local_irq_restore(flags);
+
+	if (nr)
+		zs_free_batch(pool, class, handles, nr);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
+/*
+ * The object stays pinned, and so can't be migrated by zs_compact(),
+ * until zs_unmap_object() is called.
+ */
 void *zs_map_object(struct zs_pool *pool, void *handle)
 {
 	struct page *page;
@@ -711,7 +1111,9 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	pin_tag((unsigned long)handle);
+
+	obj_to_location(handle_to_obj((unsigned long)handle), &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -720,11 +1122,11 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 	if (off + class->size <= PAGE_SIZE) {
 		/* this object is contained entirely within a page */
 		area->vm_addr = kmap_atomic(page);
-		return area->vm_addr + off;
+		return area->vm_addr + off + ZS_HANDLE_SIZE;
 	}
 
 	zs_copy_map_object(area->vm_buf, page, off, class->size);
-	return area->vm_buf;
+	return area->vm_buf + ZS_HANDLE_SIZE;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
@@ -740,7 +1142,7 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	obj_to_location(handle_to_obj((unsigned long)handle), &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -751,9 +1153,235 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 	else
 		zs_copy_unmap_object(area->vm_buf, page, off, class->size);
 	put_cpu_var(zs_map_area);
+
+	unpin_tag((unsigned long)handle);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
 
+/* Copy an object, which may span two pages, from/to a linear buffer */
+static void zs_object_read(char *buf, unsigned long obj, int size)
+{
+	struct page *page;
+	unsigned long obj_idx, off;
+	int first;
+	void *addr;
+
+	obj_to_location(obj, &page, &obj_idx);
+	off = obj_idx_to_offset(page, obj_idx, size);
+	first = min_t(int, size, PAGE_SIZE - off);
+
+	addr = kmap_atomic(page);
+	memcpy(buf, addr + off, first);
+	kunmap_atomic(addr);
+	if (first < size) {
+		addr = kmap_atomic(get_next_page(page));
+		memcpy(buf + first, addr, size - first);
+		kunmap_atomic(addr);
+	}
+}
+
+static void zs_object_write(unsigned long obj, const char *buf, int size)
+{
+	struct page *page;
+	unsigned long obj_idx, off;
+	int first;
+	void *addr;
+
+	obj_to_location(obj, &page, &obj_idx);
+	off = obj_idx_to_offset(page, obj_idx, size);
+	first = min_t(int, size, PAGE_SIZE - off);
+
+	addr = kmap_atomic(page);
+	memcpy(addr + off, buf, first);
+	kunmap_atomic(addr);
+	if (first < size) {
+		addr = kmap_atomic(get_next_page(page));
+		memcpy(addr, buf + first, size - first);
+		kunmap_atomic(addr);
+	}
+}
+
+/* Returns the handle stored in an allocated object, or 0 if it is free */
+static unsigned long obj_to_head(unsigned long obj, int size)
+{
+	struct page *page;
+	unsigned long obj_idx, off, head;
+	struct link_free *link;
+
+	obj_to_location(obj, &page, &obj_idx);
+	off = obj_idx_to_offset(page, obj_idx, size);
+
+	link = (struct link_free *)((unsigned char *)kmap_atomic(page) + off);
+	head = link->handle;
+	kunmap_atomic(link);
+
+	if (!(head & OBJ_ALLOCATED_TAG))
+		return 0;
+	return head & ~OBJ_ALLOCATED_TAG;
+}
+
+/*
+ * Enough unused objects in the class to free at least one zspage?
+ * class->lock should be held.
+ */
+static bool zs_can_compact(struct size_class *class)
+{
+	unsigned long objs_per_zspage, objs_allocated;
+
+	objs_per_zspage = class->zspage_order * PAGE_SIZE / class->size;
+	objs_allocated = (unsigned long)class->pages_allocated /
+				class->zspage_order * objs_per_zspage;
+
+	return objs_allocated - class->objs_inuse >= objs_per_zspage;
+}
+
+/* Take a zspage of the given fullness group off its list */
+static struct page *isolate_zspage(struct size_class *class,
+				enum fullness_group fg)
+{
+	struct page *first_page = class->fullness_list[fg];
+
+	if (first_page)
+		remove_zspage(first_page, class, fg);
+
+	return first_page;
+}
+
+static void putback_zspage(struct zs_pool *pool, struct size_class *class,
+				struct page *first_page)
+{
+	enum fullness_group fg = get_fullness_group(first_page);
+
+	insert_zspage(first_page, class, fg);
+	set_zspage_mapping(first_page, class->index, fg);
+}
+
+/*
+ * Move the allocated objects of 'src' into other zspages of the class.
+ * Objects that are pinned (mapped or being freed) are left in place.
+ * Returns true if src ended up empty. class->lock should be held.
+ */
+static bool migrate_zspage(struct zs_pool *pool, struct size_class *class,
+				struct page *src, struct page **dst, char *buf)
+{
+	struct page *page = src;
+	unsigned long obj_idx = 0;
+	unsigned long used_obj, free_obj, handle;
+	int i, objects = src->objects;
+
+	for (i = 0; i < objects && src->inuse; i++, obj_idx++) {
+		if (obj_idx_to_offset(page, obj_idx, class->size) >=
+				PAGE_SIZE) {
+			page = get_next_page(page);
+			if (!page)
+				break;
+			obj_idx = 0;
+		}
+
+		used_obj = location_to_obj(page, obj_idx);
+		handle = obj_to_head(used_obj, class->size);
+		if (!handle)
+			continue;
+
+		if (!*dst) {
+			*dst = isolate_zspage(class, ZS_ALMOST_FULL);
+			if (!*dst)
+				*dst = isolate_zspage(class, ZS_ALMOST_EMPTY);
+			if (!*dst)
+				break;
+		}
+
+		if (!trypin_tag(handle))
+			continue;
+
+		free_obj = obj_malloc(class, *dst, handle);
+		zs_object_read(buf, used_obj, class->size);
+		/* keep the new object's head, which refers to the handle */
+		zs_object_write(free_obj, buf, class->size);
+		/* keep the pin bit set while switching the handle over */
+		record_obj(handle, free_obj | (1UL << HANDLE_PIN_BIT));
+		unpin_tag(handle);
+		obj_free(class, used_obj);
+
+		if ((*dst)->inuse == (*dst)->objects) {
+			putback_zspage(pool, class, *dst);
+			*dst = NULL;
+		}
+	}
+
+	return src->inuse == 0;
+}
+
+static unsigned long __zs_compact(struct zs_pool *pool,
+				struct size_class *class, char *buf)
+{
+	struct page *src, *dst = NULL;
+	unsigned long freed = 0;
+	bool empty;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class)) {
+		src = isolate_zspage(class, ZS_ALMOST_EMPTY);
+		if (!src)
+			break;
+
+		empty = migrate_zspage(pool, class, src, &dst, buf);
+		if (dst) {
+			putback_zspage(pool, class, dst);
+			dst = NULL;
+		}
+
+		if (!empty) {
+			/* pinned objects or no room left: stop here */
+			putback_zspage(pool, class, src);
+			break;
+		}
+
+		class->pages_allocated -= class->zspage_order;
+		class->pages_compacted += class->zspage_order;
+		freed += class->zspage_order;
+		spin_unlock(&class->lock);
+
+		free_zspage(src);
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - Free sparsely used zspages by moving their objects
+ * @pool: pool to compact
+ *
+ * Objects of ZS_ALMOST_EMPTY zspages are moved into other zspages of
+ * the same size class, so the emptied zspages can be freed. Handles
+ * stay valid. Must be called from process context.
+ *
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	char *buf;
+	unsigned long freed = 0;
+
+	buf = kmalloc(ZS_MAX_ALLOC_SIZE, GFP_KERNEL);
+	if (!buf)
+		return 0;
+
+	/* Cached objects would keep their zspages from being emptied */
+	zs_cache_drain_all(pool);
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		freed += __zs_compact(pool, &pool->size_class[i], buf);
+
+	kfree(buf);
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
 u64 zs_get_total_size_bytes(struct zs_pool *pool)
 {
 	int i;
@@ -28,4 +28,6 @@ void zs_unmap_object(struct zs_pool *pool, void *handle);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
 
+unsigned long zs_compact(struct zs_pool *pool);
+
 #endif
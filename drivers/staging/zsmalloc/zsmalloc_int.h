@@ -34,12 +34,18 @@
 
 /*
  * Object location (<PFN>, <obj_idx>) is encoded as
- * as single (void *) handle value.
+ * as single unsigned long 'obj' value.
  *
  * Note that object index <obj_idx> is relative to system
  * page <PFN> it is stored in, so for each sub-page belonging
  * to a zspage, obj_idx starts with 0.
  *
+ * The lowest OBJ_TAG_BITS of an obj are always zero. In a handle
+ * that bit is used as the lock that pins the object in place while it
+ * is mapped, freed or migrated; in the first word of an object it tells
+ * allocated objects (which store their handle there) from free ones
+ * (which store the next free obj).
+ *
  * This is made more complicated by various memory models and PAE.
  */
 
@@ -55,7 +61,10 @@
 #endif
 #endif
 #define _PFN_BITS		(MAX_PHYSMEM_BITS - PAGE_SHIFT)
-#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS)
+#define OBJ_TAG_BITS		1
+#define OBJ_ALLOCATED_TAG	1
+#define HANDLE_PIN_BIT		0
+#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS - OBJ_TAG_BITS)
 #define OBJ_INDEX_MASK	((_AC(1, UL) << OBJ_INDEX_BITS) - 1)
 
 #define MAX(a, b) ((a) >= (b) ? (a) : (b))
@@ -64,6 +73,9 @@
 	MAX(32, (ZS_MAX_PAGES_PER_ZSPAGE << PAGE_SHIFT >> OBJ_INDEX_BITS))
 #define ZS_MAX_ALLOC_SIZE	PAGE_SIZE
 
+/* Each object starts with the handle that refers to it */
+#define ZS_HANDLE_SIZE		(sizeof(unsigned long))
+
 /*
  * On systems with 4K page size, this gives 254 size classes! There is a
  * trader-off here:
@@ -109,6 +121,23 @@ enum fullness_group {
  */
 static const int fullness_threshold_frac = 4;
 
+/*
+ * Each CPU keeps up to ZS_CPU_CACHE_SIZE ready-made objects per size
+ * class, so most zs_malloc()/zs_free() calls don't need class->lock.
+ * The cache is refilled and drained ZS_CPU_CACHE_BATCH objects at a time.
+ */
+#define ZS_CPU_CACHE_SIZE	16
+#define ZS_CPU_CACHE_BATCH	(ZS_CPU_CACHE_SIZE / 2)
+
+/*
+ * Objects in the cache are allocated as far as the zspage is concerned,
+ * and are only ever touched by their own CPU with interrupts disabled.
+ */
+struct zs_cpu_cache {
+	int count;
+	unsigned long handles[ZS_CPU_CACHE_SIZE];
+};
+
 struct mapping_area {
 	char *vm_buf; /* copy buffer for objects that span pages */
 	char *vm_addr; /* address of kmap_atomic()'ed pages */
@@ -127,8 +156,12 @@ struct size_class {
 
 	spinlock_t lock;
 
+	struct zs_cpu_cache __percpu *cache;
+
 	/* stats */
 	u64 pages_allocated;
+	unsigned long objs_inuse;	/* no. of allocated objects */
+	unsigned long pages_compacted;	/* pages freed by zs_compact() */
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -136,12 +169,17 @@ struct size_class {
 /*
  * Placed within free objects to form a singly linked list.
  * For every zspage, first_page->freelist gives head of this list.
+ * Allocated objects keep their handle in the same place instead.
  *
  * This must be power of 2 and less than or equal to ZS_ALIGN
  */
 struct link_free {
-	/* Handle of next free chunk (encodes <PFN, obj_idx>) */
-	void *next;
+	union {
+		/* Next free chunk (encodes <PFN, obj_idx>) */
+		unsigned long next;
+		/* Handle of allocated object, OR'ed with OBJ_ALLOCATED_TAG */
+		unsigned long handle;
+	};
 };
 
 struct zs_pool {
@@ -149,6 +187,12 @@ struct zs_pool {
 
 	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
+
+	struct list_head list;	/* in zs_pools, for cpu hotplug */
+
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *stat_dentry;
+#endif
 };
 
 #endif
@@ -555,6 +555,13 @@ static struct dentry *ecryptfs_mount(struct file_system_type *fs_type, int flags
 
 	ecryptfs_set_superblock_lower(s, path.dentry->d_sb);
 
+	s->s_stack_depth = path.dentry->d_sb->s_stack_depth + 1;
+	rc = -EINVAL;
+	if (s->s_stack_depth > FILESYSTEM_MAX_STACK_DEPTH) {
+		printk(KERN_ERR "eCryptfs: maximum fs stacking depth exceeded\n");
+		goto out_free;
+	}
+
 	/**
 	 * Set the POSIX ACL flag based on whether they're enabled in the lower
 	 * mount. Force a read-only eCryptfs mount if the lower mount is ro.
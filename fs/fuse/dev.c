@@ -26,43 +26,74 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_dev *fuse_get_dev(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
-	 * once during mount and is valid until the file is released.
+	 * once during mount or cloning and is valid until the file is
+	 * released.
 	 */
 	return file->private_data;
 }
 
-static void fuse_request_init(struct fuse_req *req)
+static struct fuse_conn *fuse_get_conn(struct file *file)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+
+	return fud ? fud->fc : NULL;
+}
+
+static void fuse_request_init(struct fuse_req *req, struct page **pages,
+			      unsigned npages)
 {
 	memset(req, 0, sizeof(*req));
+	memset(pages, 0, sizeof(*pages) * npages);
 	INIT_LIST_HEAD(&req->list);
 	INIT_LIST_HEAD(&req->intr_entry);
 	init_waitqueue_head(&req->waitq);
 	atomic_set(&req->count, 1);
+	req->pages = pages;
+	req->max_pages = npages;
 }
 
-struct fuse_req *fuse_request_alloc(void)
+static struct fuse_req *__fuse_request_alloc(unsigned npages, gfp_t flags)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_KERNEL);
-	if (req)
-		fuse_request_init(req);
+	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, flags);
+	if (req) {
+		struct page **pages;
+
+		if (npages <= FUSE_REQ_INLINE_PAGES) {
+			pages = req->inline_pages;
+			npages = FUSE_REQ_INLINE_PAGES;
+		} else {
+			pages = kmalloc(sizeof(struct page *) * npages, flags);
+		}
+
+		if (!pages) {
+			kmem_cache_free(fuse_req_cachep, req);
+			return NULL;
+		}
+
+		fuse_request_init(req, pages, npages);
+	}
 	return req;
 }
+
+struct fuse_req *fuse_request_alloc(unsigned npages)
+{
+	return __fuse_request_alloc(npages, GFP_KERNEL);
+}
 EXPORT_SYMBOL_GPL(fuse_request_alloc);
 
-struct fuse_req *fuse_request_alloc_nofs(void)
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_NOFS);
-	if (req)
-		fuse_request_init(req);
-	return req;
+	return __fuse_request_alloc(npages, GFP_NOFS);
 }
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -98,7 +129,7 @@ static void fuse_req_init_context(struct fuse_req *req)
 	req->in.h.pid = current->pid;
 }
 
-struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages)
 {
 	struct fuse_req *req;
 	sigset_t oldset;
@@ -117,7 +148,7 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	if (!fc->connected)
 		goto out;
 
-	req = fuse_request_alloc();
+	req = fuse_request_alloc(npages);
 	err = -ENOMEM;
 	if (!req)
 		goto out;
@@ -130,6 +161,12 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	atomic_dec(&fc->num_waiting);
 	return ERR_PTR(err);
 }
+EXPORT_SYMBOL_GPL(fuse_get_req_pages);
+
+struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+{
+	return fuse_get_req_pages(fc, FUSE_REQ_INLINE_PAGES);
+}
 EXPORT_SYMBOL_GPL(fuse_get_req);
 
 /*
@@ -167,7 +204,7 @@ static void put_reserved_req(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_file *ff = file->private_data;
 
 	spin_lock(&fc->lock);
-	fuse_request_init(req);
+	fuse_request_init(req, req->pages, req->max_pages);
 	BUG_ON(ff->reserved_req);
 	ff->reserved_req = req;
 	wake_up_all(&fc->reserved_req_waitq);
@@ -194,7 +231,7 @@ struct fuse_req *fuse_get_req_nofail(struct fuse_conn *fc, struct file *file)
 
 	atomic_inc(&fc->num_waiting);
 	wait_event(fc->blocked_waitq, !fc->blocked);
-	req = fuse_request_alloc();
+	req = fuse_request_alloc(0);
 	if (!req)
 		req = get_reserved_req(fc, file);
 
@@ -209,6 +246,11 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		if (req->passthrough_filp) {
+			fput(req->passthrough_filp);
+			req->passthrough_filp = NULL;
+		}
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -238,17 +280,34 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/*
+ * Requests go to the queue of the submitting CPU if a device file is
+ * bound to it, so that they are read and answered by a daemon thread
+ * on the same CPU.  Otherwise they go to the shared pending list.
+ */
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_pqueue *pq = NULL;
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	if (fc->pqueues) {
+		pq = &fc->pqueues[smp_processor_id()];
+		if (!pq->readers)
+			pq = NULL;
+	}
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
+	if (pq) {
+		list_add_tail(&req->list, &pq->pending);
+		wake_up(&pq->waitq);
+	} else {
+		list_add_tail(&req->list, &fc->pending);
+		wake_up(&fc->waitq);
+	}
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
@@ -915,21 +974,27 @@ static int forget_pending(struct fuse_conn *fc)
 	return fc->forget_list_head.next != NULL;
 }
 
-static int request_pending(struct fuse_conn *fc)
+static int request_pending(struct fuse_conn *fc, struct fuse_pqueue *pq)
 {
 	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
-		forget_pending(fc);
+		forget_pending(fc) || (pq && !list_empty(&pq->pending));
 }
 
-/* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
+/*
+ * Wait until a request is available on the pending list, or on the
+ * queue the reader is bound to
+ */
+static void request_wait(struct fuse_conn *fc, struct fuse_pqueue *pq)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
 	DECLARE_WAITQUEUE(wait, current);
+	DECLARE_WAITQUEUE(pq_wait, current);
 
 	add_wait_queue_exclusive(&fc->waitq, &wait);
-	while (fc->connected && !request_pending(fc)) {
+	if (pq)
+		add_wait_queue_exclusive(&pq->waitq, &pq_wait);
+	while (fc->connected && !request_pending(fc, pq)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
 			break;
@@ -939,6 +1004,8 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
+	if (pq)
+		remove_wait_queue(&pq->waitq, &pq_wait);
 	remove_wait_queue(&fc->waitq, &wait);
 }
 
@@ -1107,23 +1174,27 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
 	int err;
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_pqueue *pq;
+	struct list_head *pending;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
 
  restart:
 	spin_lock(&fc->lock);
+	pq = fud->pq;
 	err = -EAGAIN;
 	if ((file->f_flags & O_NONBLOCK) && fc->connected &&
-	    !request_pending(fc))
+	    !request_pending(fc, pq))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(fc, pq);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
 	err = -ERESTARTSYS;
-	if (!request_pending(fc))
+	if (!request_pending(fc, pq))
 		goto err_unlock;
 
 	if (!list_empty(&fc->interrupts)) {
@@ -1132,15 +1203,27 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		return fuse_read_interrupt(fc, cs, nbytes, req);
 	}
 
+	/* Requests from our own CPU come first */
+	pending = &fc->pending;
+	if (pq && !list_empty(&pq->pending)) {
+		pending = &pq->pending;
+		/*
+		 * We may have been woken for the shared list, pass that
+		 * wakeup on to another reader
+		 */
+		if (!list_empty(&fc->pending))
+			wake_up(&fc->waitq);
+	}
+
 	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
+		if (list_empty(pending) || fc->forget_batch-- > 0)
 			return fuse_read_forget(fc, cs, nbytes);
 
 		if (fc->forget_batch <= -8)
 			fc->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = list_entry(pending->next, struct fuse_req, list);
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1545,14 +1628,25 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 	loff_t file_size;
 	unsigned int num;
 	unsigned int offset;
+	unsigned int num_pages;
 	size_t total_len = 0;
 
-	req = fuse_get_req(fc);
+	offset = outarg->offset & ~PAGE_CACHE_MASK;
+	file_size = i_size_read(inode);
+
+	num = outarg->size;
+	if (outarg->offset > file_size)
+		num = 0;
+	else if (outarg->offset + num > file_size)
+		num = file_size - outarg->offset;
+
+	num_pages = (num + offset + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	num_pages = min(num_pages, fc->max_pages);
+
+	req = fuse_get_req_pages(fc, num_pages);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
 
-	offset = outarg->offset & ~PAGE_CACHE_MASK;
-
 	req->in.h.opcode = FUSE_NOTIFY_REPLY;
 	req->in.h.nodeid = outarg->nodeid;
 	req->in.numargs = 2;
@@ -1561,14 +1655,8 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 	req->end = fuse_retrieve_end;
 
 	index = outarg->offset >> PAGE_CACHE_SHIFT;
-	file_size = i_size_read(inode);
-	num = outarg->size;
-	if (outarg->offset > file_size)
-		num = 0;
-	else if (outarg->offset + num > file_size)
-		num = file_size - outarg->offset;
 
-	while (num && req->num_pages < FUSE_MAX_PAGES_PER_REQ) {
+	while (num && req->num_pages < num_pages) {
 		struct page *page;
 		unsigned int this_num;
 
@@ -1782,6 +1870,10 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
+	/* Must run in the daemon's context to look up its fd */
+	if (!err && !oh.error)
+		fuse_passthrough_setup(fc, req);
+
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (!err) {
@@ -1894,16 +1986,25 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_conn *fc;
+	struct fuse_pqueue *pq;
+	if (!fud)
 		return POLLERR;
 
+	fc = fud->fc;
+	spin_lock(&fc->lock);
+	pq = fud->pq;
+	spin_unlock(&fc->lock);
+
 	poll_wait(file, &fc->waitq, wait);
+	if (pq)
+		poll_wait(file, &pq->waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
 		mask = POLLERR;
-	else if (request_pending(fc))
+	else if (request_pending(fc, pq))
 		mask |= POLLIN | POLLRDNORM;
 	spin_unlock(&fc->lock);
 
@@ -1972,6 +2073,12 @@ __acquires(fc->lock)
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
 	end_requests(fc, &fc->pending);
+	if (fc->pqueues) {
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			end_requests(fc, &fc->pqueues[cpu].pending);
+	}
 	end_requests(fc, &fc->processing);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
@@ -2028,24 +2135,197 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+/*
+ * Detach the device file from its queue.  Requests left on the queue
+ * when its last reader goes away are handed back to the shared list.
+ *
+ * Called with fc->lock held
+ */
+static void fuse_dev_unbind(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_pqueue *pq = fud->pq;
+
+	if (!pq)
+		return;
+
+	fud->pq = NULL;
+	if (!--pq->readers && !list_empty(&pq->pending)) {
+		list_splice_tail_init(&pq->pending, &fc->pending);
+		wake_up(&fc->waitq);
+	}
+}
+
+/*
+ * The connection goes away with the last device file, clones of the
+ * mount-time file keep it alive.
+ */
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (fud) {
+		struct fuse_conn *fc = fud->fc;
+
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
+		fuse_dev_unbind(fud);
+		if (atomic_dec_and_test(&fc->dev_count)) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			end_queued_requests(fc);
+			end_polls(fc);
+			wake_up_all(&fc->blocked_waitq);
+		}
 		spin_unlock(&fc->lock);
 		fuse_conn_put(fc);
+		kfree(fud);
 	}
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(fuse_dev_release);
 
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud;
+
+	fud = kzalloc(sizeof(struct fuse_dev), GFP_KERNEL);
+	if (fud) {
+		fud->fc = fc;
+		atomic_inc(&fc->dev_count);
+	}
+
+	return fud;
+}
+EXPORT_SYMBOL_GPL(fuse_dev_alloc);
+
+/*
+ * Attach a freshly opened /dev/fuse file to the connection of an
+ * already mounted one, so that a multithreaded daemon can give each
+ * thread its own file (and queue).
+ */
+static int fuse_dev_clone(struct file *file, int oldfd)
+{
+	struct file *old;
+	struct fuse_dev *fud;
+	struct fuse_dev *new_fud;
+	int err;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EBADF;
+
+	err = -EINVAL;
+	if (old->f_op != &fuse_dev_operations ||
+	    file->f_op != &fuse_dev_operations)
+		goto out_fput;
+
+	mutex_lock(&fuse_mutex);
+	fud = fuse_get_dev(old);
+	if (!fud || file->private_data)
+		goto out_unlock;
+
+	err = -ENOMEM;
+	new_fud = fuse_dev_alloc(fuse_conn_get(fud->fc));
+	if (!new_fud) {
+		fuse_conn_put(fud->fc);
+		goto out_unlock;
+	}
+
+	/* Make the initialized fuse_dev visible before the pointer */
+	smp_wmb();
+	file->private_data = new_fud;
+	err = 0;
+
+ out_unlock:
+	mutex_unlock(&fuse_mutex);
+ out_fput:
+	fput(old);
+	return err;
+}
+
+static struct fuse_pqueue *fuse_pqueues_alloc(void)
+{
+	struct fuse_pqueue *pqueues;
+	int cpu;
+
+	pqueues = kcalloc(nr_cpu_ids, sizeof(struct fuse_pqueue), GFP_KERNEL);
+	if (!pqueues)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		INIT_LIST_HEAD(&pqueues[cpu].pending);
+		init_waitqueue_head(&pqueues[cpu].waitq);
+	}
+
+	return pqueues;
+}
+
+/*
+ * Bind the device file to the queue of the given CPU, or unbind it if
+ * cpu is ~0U.  A reader bound to a queue only sees requests submitted
+ * on that CPU in addition to the shared ones, so it is best run with
+ * its affinity set to the same CPU.
+ */
+static int fuse_dev_bind_queue(struct fuse_dev *fud, u32 cpu)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_pqueue *pqueues = NULL;
+
+	if (cpu != ~0U) {
+		if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+			return -EINVAL;
+
+		if (!fc->pqueues) {
+			pqueues = fuse_pqueues_alloc();
+			if (!pqueues)
+				return -ENOMEM;
+		}
+	}
+
+	spin_lock(&fc->lock);
+	fuse_dev_unbind(fud);
+	if (cpu != ~0U) {
+		if (!fc->pqueues) {
+			fc->pqueues = pqueues;
+			pqueues = NULL;
+		}
+		fud->pq = &fc->pqueues[cpu];
+		fud->pq->readers++;
+	}
+	spin_unlock(&fc->lock);
+	kfree(pqueues);
+
+	return 0;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct fuse_dev *fud;
+	u32 val;
+
+	switch (cmd) {
+	case FUSE_DEV_IOC_CLONE:
+		if (get_user(val, (u32 __user *) arg))
+			return -EFAULT;
+
+		return fuse_dev_clone(file, val);
+
+	case FUSE_DEV_IOC_BIND_QUEUE:
+		fud = fuse_get_dev(file);
+		if (!fud)
+			return -EPERM;
+
+		if (get_user(val, (u32 __user *) arg))
+			return -EFAULT;
+
+		return fuse_dev_bind_queue(fud, val);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
@@ -2068,6 +2348,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
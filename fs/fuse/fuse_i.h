@@ -23,9 +23,18 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
+/** Default max number of pages that can be used in a single request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+/** Upper limit for the max_pages negotiated at INIT (1MiB with 4k pages) */
+#define FUSE_MAX_MAX_PAGES 256
+
+/** Magic number of the fuse filesystem */
+#define FUSE_SUPER_MAGIC 0x65735546
+
+/** Number of page pointers embedded in fuse_req */
+#define FUSE_REQ_INLINE_PAGES 1
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -139,6 +148,9 @@ struct fuse_file {
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
 
+	/** Lower file that read/write/mmap are passed through to, or NULL */
+	struct file *passthrough_filp;
+
 	/** Has flock been performed on this file? */
 	bool flock:1;
 };
@@ -291,7 +303,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the 'pages' array */
+	unsigned max_pages;
+
+	/** inline page vector, used when max_pages is small */
+	struct page *inline_pages[FUSE_REQ_INLINE_PAGES];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -313,6 +331,40 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Lower file from an OPEN or CREATE reply, see passthrough.c */
+	struct file *passthrough_filp;
+};
+
+/**
+ * Per-CPU queue of pending requests
+ *
+ * Requests submitted on a CPU that has device files bound to it are
+ * queued here instead of on fc->pending, and read by those files first.
+ */
+struct fuse_pqueue {
+	/** The list of pending requests submitted on this CPU */
+	struct list_head pending;
+
+	/** Readers bound to this queue are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** Number of device files bound to this queue */
+	unsigned readers;
+};
+
+/**
+ * A device file attached to a connection.
+ *
+ * There is one for the file passed at mount time and one for each clone
+ * made with FUSE_DEV_IOC_CLONE.
+ */
+struct fuse_dev {
+	/** The connection, a reference is held */
+	struct fuse_conn *fc;
+
+	/** Queue this file is bound to or NULL, protected by fc->lock */
+	struct fuse_pqueue *pq;
 };
 
 /**
@@ -347,12 +399,21 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
 	/** The list of pending requests */
 	struct list_head pending;
 
+	/** Per-CPU pending queues, allocated when a device file is bound */
+	struct fuse_pqueue *pqueues;
+
+	/** Number of device files attached to the connection */
+	atomic_t dev_count;
+
 	/** The list of requests being processed */
 	struct list_head processing;
 
@@ -478,6 +539,9 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Can file I/O be passed through to a lower file? */
+	unsigned passthrough:1;
+
 	/** Are BSD file locking primitives not implemented by fs? */
 	unsigned no_flock:1;
 
@@ -650,11 +714,11 @@ int fuse_ctl_init(void);
 void fuse_ctl_cleanup(void);
 
 /**
- * Allocate a request
+ * Allocate a request with room for npages pages
  */
-struct fuse_req *fuse_request_alloc(void);
+struct fuse_req *fuse_request_alloc(unsigned npages);
 
-struct fuse_req *fuse_request_alloc_nofs(void);
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages);
 
 /**
  * Free a request
@@ -666,6 +730,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for npages pages, may fail with -ENOMEM
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -779,6 +848,21 @@ long fuse_ioctl_common(struct file *file, unsigned int cmd,
 unsigned fuse_file_poll(struct file *file, poll_table *wait);
 int fuse_dev_release(struct inode *inode, struct file *file);
 
+/**
+ * Allocate a device file for the connection, the caller passes in its
+ * reference to fc
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/* passthrough.c */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+bool fuse_passthrough_open(struct file *file, struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
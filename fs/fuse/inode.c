@@ -47,7 +47,6 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
-#define FUSE_SUPER_MAGIC 0x65735546
 
 #define FUSE_DEFAULT_BLKSIZE 512
 
@@ -549,6 +548,7 @@ void fuse_conn_init(struct fuse_conn *fc)
 	fc->forget_list_tail = &fc->forget_list_head;
 	atomic_set(&fc->num_waiting, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
+	fc->max_pages = FUSE_MAX_PAGES_PER_REQ;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
 	fc->khctr = 0;
 	fc->polled_files = RB_ROOT;
@@ -565,6 +565,7 @@ void fuse_conn_put(struct fuse_conn *fc)
 		if (fc->destroy_req)
 			fuse_request_free(fc->destroy_req);
 		mutex_destroy(&fc->inst_mutex);
+		kfree(fc->pqueues);
 		fc->release(fc);
 	}
 }
@@ -806,6 +807,14 @@ static void process_init_limits(struct fuse_conn *fc, struct fuse_init_out *arg)
 	}
 }
 
+/* Whether the INIT reply was long enough to carry max_pages */
+static bool fuse_init_has_max_pages(struct fuse_req *req)
+{
+	return req->out.args[0].size >=
+		offsetof(struct fuse_init_out, max_pages) +
+		sizeof(req->misc.init_out.max_pages);
+}
+
 static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 {
 	struct fuse_init_out *arg = &req->misc.init_out;
@@ -841,6 +850,18 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 				fc->big_writes = 1;
 			if (arg->flags & FUSE_DONT_MASK)
 				fc->dont_mask = 1;
+			if (arg->minor >= 19) {
+				if (arg->flags & FUSE_PASSTHROUGH)
+					fc->passthrough = 1;
+				/* 0 means the daemon kept the default */
+				if ((arg->flags & FUSE_MAX_PAGES) &&
+				    fuse_init_has_max_pages(req) &&
+				    arg->max_pages) {
+					fc->max_pages = min_t(unsigned,
+						FUSE_MAX_MAX_PAGES,
+						arg->max_pages);
+				}
+			}
 		} else {
 			ra_pages = fc->max_read / PAGE_CACHE_SIZE;
 			fc->no_lock = 1;
@@ -866,7 +887,7 @@ static void fuse_send_init(struct fuse_conn *fc, struct fuse_req *req)
 	arg->max_readahead = fc->bdi.ra_pages * PAGE_CACHE_SIZE;
 	arg->flags |= FUSE_ASYNC_READ | FUSE_POSIX_LOCKS | FUSE_ATOMIC_O_TRUNC |
 		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK |
-		FUSE_FLOCK_LOCKS;
+		FUSE_FLOCK_LOCKS | FUSE_MAX_PAGES | FUSE_PASSTHROUGH;
 	req->in.h.opcode = FUSE_INIT;
 	req->in.numargs = 1;
 	req->in.args[0].size = sizeof(*arg);
@@ -932,6 +953,7 @@ static int fuse_bdi_init(struct fuse_conn *fc, struct super_block *sb)
 static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct fuse_conn *fc;
+	struct fuse_dev *fud;
 	struct inode *root;
 	struct fuse_mount_data d;
 	struct file *file;
@@ -960,6 +982,8 @@ static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 		sb->s_blocksize_bits = PAGE_CACHE_SHIFT;
 	}
 	sb->s_magic = FUSE_SUPER_MAGIC;
+	/* Passthrough may stack file I/O on another filesystem */
+	sb->s_stack_depth = 1;
 	sb->s_op = &fuse_super_operations;
 	sb->s_maxbytes = MAX_LFS_FILESIZE;
 	sb->s_time_gran = 1;
@@ -1010,12 +1034,12 @@ static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 	/* only now - we want root dentry with NULL ->d_op */
 	sb->s_d_op = &fuse_dentry_operations;
 
-	init_req = fuse_request_alloc();
+	init_req = fuse_request_alloc(0);
 	if (!init_req)
 		goto err_put_root;
 
 	if (is_bdev) {
-		fc->destroy_req = fuse_request_alloc();
+		fc->destroy_req = fuse_request_alloc(0);
 		if (!fc->destroy_req)
 			goto err_free_init_req;
 	}
@@ -1025,14 +1049,20 @@ static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 	if (file->private_data)
 		goto err_unlock;
 
+	err = -ENOMEM;
+	fud = fuse_dev_alloc(fc);
+	if (!fud)
+		goto err_unlock;
+
 	err = fuse_ctl_add_conn(fc);
 	if (err)
-		goto err_unlock;
+		goto err_free_dev;
 
 	list_add_tail(&fc->entry, &fuse_conn_list);
 	sb->s_root = root_dentry;
 	fc->connected = 1;
-	file->private_data = fuse_conn_get(fc);
+	fuse_conn_get(fc);
+	file->private_data = fud;
 	mutex_unlock(&fuse_mutex);
 	/*
 	 * atomic_dec_and_test() in fput() provides the necessary
@@ -1045,6 +1075,8 @@ static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 
 	return 0;
 
+ err_free_dev:
+	kfree(fud);
  err_unlock:
 	mutex_unlock(&fuse_mutex);
  err_free_init_req:
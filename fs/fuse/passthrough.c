@@ -0,0 +1,184 @@
+/*
+  FUSE: Filesystem in Userspace
+  Passthrough of file I/O to a lower file
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+#include <linux/uio.h>
+
+/* Open flags that change what a read or write of the lower file does */
+#define FUSE_PASSTHROUGH_FLAGS	(O_APPEND | O_DSYNC | __O_SYNC | O_DIRECT)
+
+/*
+ * If the connection negotiated FUSE_PASSTHROUGH, the daemon may answer
+ * OPEN or CREATE with FOPEN_PASSTHROUGH and one of its own file
+ * descriptors in passthrough_fd.  The file is looked up here, while we
+ * are still running in the daemon's write(), and handed to the opener
+ * through req->passthrough_filp.  Reads, writes and mmaps of the fuse
+ * file then go straight to the lower file; everything else still goes
+ * through the daemon.
+ *
+ * Any problem with the descriptor simply leaves the file on the normal
+ * fuse I/O path.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *open_out;
+	struct file *lower;
+
+	if (!fc->passthrough)
+		return;
+
+	if (req->in.h.opcode != FUSE_OPEN && req->in.h.opcode != FUSE_CREATE)
+		return;
+
+	open_out = req->out.args[req->out.numargs - 1].value;
+	if (!(open_out->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	lower = fget(open_out->passthrough_fd);
+	if (!lower)
+		return;
+
+	/*
+	 * Only regular files, and no stacking on top of fuse, ecryptfs or
+	 * anything else that is itself stacked on another filesystem.
+	 */
+	if (!S_ISREG(lower->f_path.dentry->d_inode->i_mode) ||
+	    !lower->f_op || !lower->f_op->aio_read || !lower->f_op->aio_write ||
+	    lower->f_path.dentry->d_sb->s_stack_depth > 0) {
+		fput(lower);
+		return;
+	}
+
+	req->passthrough_filp = lower;
+}
+
+static bool fuse_passthrough_flags_match(struct file *file,
+					 struct file *lower)
+{
+	return !((file->f_flags ^ lower->f_flags) & FUSE_PASSTHROUGH_FLAGS);
+}
+
+/*
+ * The lower file was opened by the daemon, with its own flags.  Only pass
+ * I/O through if they agree with the opener's on O_APPEND, O_SYNC and
+ * O_DIRECT; otherwise drop the lower file and use the normal fuse path.
+ */
+bool fuse_passthrough_open(struct file *file, struct fuse_file *ff)
+{
+	if (fuse_passthrough_flags_match(file, ff->passthrough_filp))
+		return true;
+
+	fput(ff->passthrough_filp);
+	ff->passthrough_filp = NULL;
+	return false;
+}
+
+/*
+ * Reads and writes call the lower file's aio methods directly, so do the
+ * checks and notifications vfs_read() and vfs_write() would do for it.
+ * O_APPEND and O_DIRECT can still be changed with F_SETFL after open;
+ * refuse I/O once the fuse file and the lower file disagree.
+ */
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	ssize_t ret;
+
+	if (!(lower->f_mode & FMODE_READ))
+		return -EBADF;
+
+	if (!fuse_passthrough_flags_match(file, lower))
+		return -EINVAL;
+
+	ret = rw_verify_area(READ, lower, &pos, iov_length(iov, nr_segs));
+	if (ret < 0)
+		return ret;
+
+	iocb->ki_filp = lower;
+	ret = lower->f_op->aio_read(iocb, iov, nr_segs, pos);
+	iocb->ki_filp = file;
+
+	if (ret > 0)
+		fsnotify_access(lower);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	ssize_t ret;
+
+	if (!(lower->f_mode & FMODE_WRITE))
+		return -EBADF;
+
+	if (!fuse_passthrough_flags_match(file, lower))
+		return -EINVAL;
+
+	ret = rw_verify_area(WRITE, lower, &pos, iov_length(iov, nr_segs));
+	if (ret < 0)
+		return ret;
+
+	iocb->ki_filp = lower;
+	ret = lower->f_op->aio_write(iocb, iov, nr_segs, pos);
+	iocb->ki_filp = file;
+
+	if (ret > 0 || ret == -EIOCBQUEUED) {
+		if (ret > 0)
+			fsnotify_modify(lower);
+		fuse_write_update_size(inode,
+			i_size_read(lower->f_path.dentry->d_inode));
+		fuse_invalidate_attr(inode);
+		/* Other openers of the inode may read it through the cache */
+		invalidate_inode_pages2(inode->i_mapping);
+	}
+
+	return ret;
+}
+
+/*
+ * Map the lower file directly, so that page cache pages are shared with
+ * it and stay coherent with passed through reads and writes.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE) &&
+	    !(lower->f_mode & FMODE_WRITE))
+		return -EACCES;
+
+	vma->vm_file = lower;
+	get_file(lower);
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+
+	return ret;
+}
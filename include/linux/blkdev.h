@@ -130,7 +130,7 @@ struct request {
 	struct gendisk *rq_disk;
 	struct hd_struct *part;
 	unsigned long start_time;
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
 #endif
@@ -240,6 +240,28 @@ struct blk_queue_tag {
 	atomic_t refcnt;		/* map can be shared */
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * Completion latency, bucketed by log2 of the time in usecs from
+ * allocation to completion, and queue depth seen at dispatch.
+ */
+#define BLK_LAT_HIST_BUCKETS	24
+#define BLK_DEPTH_HIST_BUCKETS	10
+
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_WRITE,		/* async writes */
+	BLK_LAT_SYNC,		/* sync writes */
+	BLK_LAT_FLUSH,		/* flush and FUA requests */
+	BLK_LAT_NR,
+};
+
+struct blk_latency_hist {
+	unsigned long		lat[BLK_LAT_NR][BLK_LAT_HIST_BUCKETS];
+	unsigned long		depth[BLK_DEPTH_HIST_BUCKETS];
+};
+#endif
+
 #define BLK_SCSI_MAX_CMDS	(256)
 #define BLK_SCSI_CMD_PER_LONG	(BLK_SCSI_MAX_CMDS / (sizeof(long) * 8))
 
@@ -346,6 +368,7 @@ struct request_queue {
 	unsigned int		nr_congestion_on;
 	unsigned int		nr_congestion_off;
 	unsigned int		nr_batching;
+	unsigned int		plug_budget_kb;
 
 	unsigned int		dma_drain_size;
 	void			*dma_drain_buffer;
@@ -357,6 +380,9 @@ struct request_queue {
 
 	unsigned int		nr_sorted;
 	unsigned int		in_flight[2];
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_latency_hist	latency_hist;	/* protected by queue_lock */
+#endif
 
 	unsigned int		rq_timeout;
 	struct timer_list	timeout;
@@ -892,7 +918,14 @@ struct blk_plug {
 	struct list_head cb_list; /* md requires an unplug callback */
 	unsigned int should_sort; /* list to be sorted before flushing? */
 };
-#define BLK_MAX_REQUEST_COUNT 16
+
+/*
+ * A plug is flushed once the requests it holds for a queue add up to
+ * the queue's byte budget, see blk_plug_budget().  The request count
+ * limit only bounds the plug list walk when small requests don't merge.
+ */
+#define BLK_MAX_REQUEST_COUNT 32
+#define BLK_PLUG_DEFAULT_BUDGET_KB 1024
 
 struct blk_plug_cb {
 	struct list_head list;
@@ -1165,7 +1198,7 @@ static inline void put_dev_sector(Sector p)
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
 
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 /*
  * This should not be using sched_clock(). A real patch is in progress
  * to fix this up, until that is in place we need to disable preemption
@@ -419,4 +419,28 @@ void cpufreq_frequency_table_get_attr(struct cpufreq_frequency_table *table,
 void cpufreq_frequency_table_put_attr(unsigned int cpu);
 
 
+/*********************************************************************
+ *                     PER-TASK FREQUENCY STATISTICS                 *
+ *********************************************************************/
+
+/* Distinct frequencies tracked per task, across all CPUs */
+#define CPUFREQ_TASK_STATES_MAX	32
+
+struct seq_file;
+struct task_struct;
+
+#ifdef CONFIG_CPU_FREQ_STAT_TASKS
+void cpufreq_task_stats_init(struct task_struct *p);
+void cpufreq_task_stats_free(struct task_struct *p);
+void cpufreq_task_stats_update(struct task_struct *p);
+void cpufreq_task_stats_add(struct task_struct *p, u64 *times);
+const unsigned int *cpufreq_task_stats_freqs(unsigned int *num);
+int cpufreq_task_stats_show(struct seq_file *m, struct task_struct *p,
+			    int whole);
+#else
+static inline void cpufreq_task_stats_init(struct task_struct *p) { }
+static inline void cpufreq_task_stats_free(struct task_struct *p) { }
+static inline void cpufreq_task_stats_update(struct task_struct *p) { }
+#endif
+
 #endif /* _LINUX_CPUFREQ_H */
@@ -35,6 +35,8 @@ struct cpuidle_state_usage {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	too_deep; /* left before target residency */
+	unsigned long long	too_shallow; /* a deeper state would have paid off */
 };
 
 struct cpuidle_state {
@@ -54,12 +54,22 @@
  * 7.18
  *  - add FUSE_IOCTL_DIR flag
  *  - add FUSE_NOTIFY_DELETE
+ *
+ * 7.19
+ *  - add FUSE_MAX_PAGES init flag and max_pages in fuse_init_out
+ *  - add FUSE_PASSTHROUGH init flag, FOPEN_PASSTHROUGH and passthrough_fd
+ *  - add FUSE_DEV_IOC_CLONE and FUSE_DEV_IOC_BIND_QUEUE device ioctls
+ *
+ * FUSE_PASSTHROUGH and FOPEN_PASSTHROUGH are local extensions, not part
+ * of the upstream protocol.  They use the top bit of each flag word so
+ * that they stay clear of the bits upstream allocates from the bottom.
  */
 
 #ifndef _LINUX_FUSE_H
 #define _LINUX_FUSE_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /*
  * Version negotiation:
@@ -85,7 +95,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 18
+#define FUSE_KERNEL_MINOR_VERSION 19
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -152,10 +162,12 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read/write/mmap go to open_out.passthrough_fd
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 31)
 
 /**
  * INIT request/reply flags
@@ -164,6 +176,8 @@ struct fuse_file_lock {
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
  * FUSE_FLOCK_LOCKS: remote locking for BSD style file locks
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
+ * FUSE_PASSTHROUGH: file I/O may be passed through to a lower file
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -173,6 +187,8 @@ struct fuse_file_lock {
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
 #define FUSE_FLOCK_LOCKS	(1 << 10)
+#define FUSE_MAX_PAGES		(1 << 22)
+#define FUSE_PASSTHROUGH	(1 << 31)
 
 /**
  * CUSE INIT request/reply flags
@@ -394,7 +410,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	__u64	fh;
 	__u32	open_flags;
-	__u32	padding;
+	__s32	passthrough_fd;	/* daemon fd, used with FOPEN_PASSTHROUGH */
 };
 
 struct fuse_release_in {
@@ -497,6 +513,10 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	unused;
+	__u16	max_pages;
+	__u16	padding;
+	__u32	unused2[8];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -645,4 +665,13 @@ struct fuse_notify_retrieve_in {
 	__u64	dummy4;
 };
 
+/* Device ioctls */
+#define FUSE_DEV_IOC_MAGIC		229
+
+/* Attach this file to the connection of the /dev/fuse fd passed in */
+#define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, __u32)
+
+/* Read requests submitted on the given CPU first, ~0 unbinds */
+#define FUSE_DEV_IOC_BIND_QUEUE		_IOW(FUSE_DEV_IOC_MAGIC, 1, __u32)
+
 #endif /* _LINUX_FUSE_H */
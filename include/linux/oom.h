@@ -43,6 +43,27 @@ enum oom_constraint {
 extern void compare_swap_oom_score_adj(int old_val, int new_val);
 extern int test_set_oom_score_adj(int new_val);
 
+/*
+ * The Android lowmemorykiller keeps processes indexed by oom_score_adj.
+ * Call these when a process is created or released, and after its
+ * oom_score_adj changed.
+ */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+extern void lowmem_adj_index_add(struct task_struct *p);
+extern void lowmem_adj_index_del(struct task_struct *p);
+extern void lowmem_adj_index_update(struct task_struct *p);
+#else
+static inline void lowmem_adj_index_add(struct task_struct *p)
+{
+}
+static inline void lowmem_adj_index_del(struct task_struct *p)
+{
+}
+static inline void lowmem_adj_index_update(struct task_struct *p)
+{
+}
+#endif
+
 extern unsigned int oom_badness(struct task_struct *p, struct mem_cgroup *memcg,
 			const nodemask_t *nodemask, unsigned long totalpages);
 extern int try_set_zonelist_oom(struct zonelist *zonelist, gfp_t gfp_flags);
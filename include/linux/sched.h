@@ -94,6 +94,7 @@ struct sched_param {
 #include <linux/latencytop.h>
 #include <linux/cred.h>
 #include <linux/llist.h>
+#include <linux/list_nulls.h>
 
 #include <asm/processor.h>
 
@@ -147,6 +148,18 @@ extern u64 nr_running_integral(unsigned int cpu);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+/*
+ * Decayed utilisation, see struct sched_avg.  A CPU that was always busy,
+ * or a task that was always running, has a utilisation of
+ * SCHED_UTIL_SCALE.
+ */
+#define SCHED_UTIL_SHIFT	10
+#define SCHED_UTIL_SCALE	(1UL << SCHED_UTIL_SHIFT)
+
+extern unsigned long sched_cpu_util(int cpu);
+extern unsigned long sched_cpu_demand(int cpu);
+extern unsigned long sched_task_util(struct task_struct *p);
+
 
 extern void calc_global_load(unsigned long ticks);
 
@@ -311,6 +324,25 @@ extern void trap_init(void);
 extern void update_process_times(int user);
 extern void scheduler_tick(void);
 
+#ifdef CONFIG_CPU_FREQ
+/*
+ * Load change callbacks for cpufreq governors.  ->func() is called on
+ * every fair class enqueue, with the runqueue locked, and on every tick
+ * after the runqueue has been unlocked.  @time is the runqueue clock in
+ * nanoseconds.  The enqueue callback must not sleep, wake tasks or take
+ * runqueue locks.
+ */
+#define SCHED_LOAD_ENQUEUE	0
+#define SCHED_LOAD_TICK		1
+
+struct sched_load_hook {
+	void (*func)(struct sched_load_hook *hook, int cpu,
+		     unsigned int nr_running, u64 time, int event);
+};
+
+extern void sched_set_load_hook(int cpu, struct sched_load_hook *hook);
+#endif
+
 extern void sched_show_task(struct task_struct *p);
 
 #ifdef CONFIG_LOCKUP_DETECTOR
@@ -669,6 +701,11 @@ struct signal_struct {
 	int oom_score_adj;	/* OOM kill score adjustment */
 	int oom_score_adj_min;	/* OOM kill score adjustment minimum value.
 				 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	/* lowmemorykiller index of processes by oom_score_adj */
+	struct hlist_nulls_node lowmem_adj_node;
+	int lowmem_adj_bucket;
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -866,6 +903,7 @@ enum cpu_idle_type {
 #define SD_ASYM_PACKING		0x0800  /* Place busy groups earlier in the domain */
 #define SD_PREFER_SIBLING	0x1000	/* Prefer to place tasks in a sibling domain */
 #define SD_OVERLAP		0x2000	/* sched_domains of this level overlap */
+#define SD_SHARE_POWERDOMAIN	0x4000	/* Domain members share power domain */
 
 enum powersavings_balance_level {
 	POWERSAVINGS_BALANCE_NONE = 0,  /* No power saving load balance */
@@ -900,6 +938,7 @@ static inline int sd_balance_for_package_power(void)
 }
 
 extern int __weak arch_sd_sibiling_asym_packing(void);
+extern int __weak arch_sd_share_power_domain(void);
 
 /*
  * Optimise SD flags for power savings:
@@ -1209,6 +1248,18 @@ struct sched_statistics {
 };
 #endif
 
+/*
+ * Per-entity load tracking: the time an entity was running, in ~1ms
+ * (1024us) periods, each period counting y times as much as the one
+ * after it, with y^32 = 1/2.  The sums are bounded by
+ * 1024 / (1 - y) ~= 47742, so a u32 holds them.
+ */
+struct sched_avg {
+	u32 running_sum, period;
+	u64 last_update;
+	unsigned long util;	/* running_sum / period, as of last_update */
+};
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
@@ -1222,6 +1273,9 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+	/* tracked for tasks only, not for group entities */
+	struct sched_avg	avg;
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1401,6 +1455,11 @@ struct task_struct {
 	cputime_t gtime;
 #ifndef CONFIG_VIRT_CPU_ACCOUNTING
 	cputime_t prev_utime, prev_stime;
+#endif
+#ifdef CONFIG_CPU_FREQ_STAT_TASKS
+	u64 *time_in_state;	/* ns at each cpufreq_task_stats_freqs() */
+	unsigned int max_state;	/* entries in time_in_state */
+	u64 cpufreq_runtime;	/* se.sum_exec_runtime last charged */
 #endif
 	unsigned long nvcsw, nivcsw; /* context switch counts */
 	struct timespec start_time; 		/* monotonic time */
@@ -2064,6 +2123,12 @@ extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
 extern unsigned int sysctl_sched_child_runs_first;
 
+#ifdef CONFIG_SMP
+extern unsigned int sysctl_sched_packing;
+extern unsigned int sysctl_sched_pack_task_pct;
+extern unsigned int sysctl_sched_pack_cpu_pct;
+#endif
+
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
 	SCHED_TUNABLESCALING_LOG,
@@ -104,6 +104,7 @@ int arch_update_cpu_topology(void);
 				| 0*SD_SERIALIZE			\
 				| 0*SD_PREFER_SIBLING			\
 				| arch_sd_sibling_asym_packing()	\
+				| 1*SD_SHARE_POWERDOMAIN		\
 				,					\
 	.last_balance		= jiffies,				\
 	.balance_interval	= 1,					\
@@ -137,6 +138,7 @@ int arch_update_cpu_topology(void);
 				| 0*SD_SERIALIZE			\
 				| sd_balance_for_mc_power()		\
 				| sd_power_saving_flags()		\
+				| arch_sd_share_power_domain()		\
 				,					\
 	.last_balance		= jiffies,				\
 	.balance_interval	= 1,					\
@@ -170,6 +172,7 @@ int arch_update_cpu_topology(void);
 				| 0*SD_SERIALIZE			\
 				| sd_balance_for_package_power()	\
 				| sd_power_saving_flags()		\
+				| arch_sd_share_power_domain()		\
 				,					\
 	.last_balance		= jiffies,				\
 	.balance_interval	= 1,					\
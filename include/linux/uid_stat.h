@@ -26,4 +26,12 @@ int uid_stat_tcp_rcv(uid_t uid, int size);
 #define uid_stat_tcp_rcv(uid, size) do {} while (0);
 #endif
 
+struct task_struct;
+
+#ifdef CONFIG_UID_TIME_IN_STATE
+void uid_time_in_state_exit(struct task_struct *p);
+#else
+static inline void uid_time_in_state_exit(struct task_struct *p) { }
+#endif
+
 #endif /* _LINUX_UID_STAT_H */
@@ -82,6 +82,27 @@ DEFINE_EVENT(loadeval, cpufreq_interactive_notyet,
 	    TP_ARGS(cpu_id, load, curtarg, curactual, newtarg)
 );
 
+TRACE_EVENT(cpufreq_interactive_sched_eval,
+	    TP_PROTO(unsigned long cpu_id, unsigned long latency,
+		     unsigned long saved),
+	    TP_ARGS(cpu_id, latency, saved),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned long, cpu_id)
+		    __field(unsigned long, latency)
+		    __field(unsigned long, saved)
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->latency = latency;
+		    __entry->saved = saved;
+	    ),
+
+	    TP_printk("cpu=%lu latency=%luus saved=%luus",
+		      __entry->cpu_id, __entry->latency, __entry->saved)
+);
+
 TRACE_EVENT(cpufreq_interactive_boost,
 	    TP_PROTO(const char *s),
 	    TP_ARGS(s),
@@ -60,6 +60,20 @@ TRACE_EVENT(input_cfboost_event,
 		__entry->name, __entry->type, __entry->code, __entry->value)
 );
 
+TRACE_EVENT(input_cfboost_qos,
+	TP_PROTO(const char *name, int min_cpus),
+	TP_ARGS(name, min_cpus),
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(int, min_cpus)
+	),
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->min_cpus = min_cpus;
+	),
+	TP_printk("name=%s min_cpus=%d", __entry->name, __entry->min_cpus)
+);
+
 #endif /*  _TRACE_INPUT_CFBOOST_H */
 
 /* This part must be outside protection */
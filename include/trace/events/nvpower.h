@@ -47,6 +47,16 @@ enum {
 	NVPOWER_MC_CLK_STOP_EXIT,
 };
 
+enum {
+	NVPOWER_CPUQUIET_MIN_CPUS,
+	NVPOWER_CPUQUIET_WORK_START,
+	NVPOWER_CPUQUIET_CLUSTER_START,
+	NVPOWER_CPUQUIET_CLUSTER_DONE,
+	NVPOWER_CPUQUIET_CPU_UP_START,
+	NVPOWER_CPUQUIET_CPU_UP_DONE,
+	NVPOWER_CPUQUIET_WORK_DONE,
+};
+
 #endif
 
 TRACE_EVENT(nvcpu_cluster,
@@ -119,6 +129,29 @@ TRACE_EVENT(nvmc_clk_stop,
 		  (unsigned long)__entry->sleep,
 		  (unsigned long)__entry->state)
 );
+TRACE_EVENT(nvcpu_cpuquiet,
+
+	TP_PROTO(int state, unsigned long arg),
+
+	TP_ARGS(state, arg),
+
+	TP_STRUCT__entry(
+		__field(u32, counter)
+		__field(u32, state)
+		__field(u32, arg)
+	),
+
+	TP_fast_assign(
+		__entry->counter = tegra_read_usec_raw();
+		__entry->state = state;
+		__entry->arg = arg;
+	),
+
+	TP_printk("counter=%lu, state=%lu, arg=%lu",
+		  (unsigned long)__entry->counter,
+		  (unsigned long)__entry->state,
+		  (unsigned long)__entry->arg)
+);
 #endif /* _TRACE_NVPOWER_H */
 
 /* This part must be outside protection */
@@ -53,6 +53,7 @@
 #include <linux/oom.h>
 #include <linux/writeback.h>
 #include <linux/shm.h>
+#include <linux/uid_stat.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -72,6 +73,7 @@ static void __unhash_process(struct task_struct *p, bool group_dead)
 		list_del_rcu(&p->tasks);
 		list_del_init(&p->sibling);
 		__this_cpu_dec(process_counts);
+		lowmem_adj_index_del(p);
 	}
 	list_del_rcu(&p->thread_group);
 }
@@ -201,6 +203,8 @@ repeat:
 	}
 
 	write_unlock_irq(&tasklist_lock);
+	/* unhashed now, so /proc/uid_time_in_state won't count it twice */
+	uid_time_in_state_exit(p);
 	release_thread(p);
 	call_rcu(&p->rcu, delayed_put_task_struct);
 
@@ -73,6 +73,7 @@
 #include <linux/init_task.h>
 #include <linux/binfmts.h>
 #include <linux/tegra_profiler.h>
+#include <linux/cpufreq.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -1729,6 +1730,7 @@ static void __sched_fork(struct task_struct *p)
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
 	p->se.vruntime			= 0;
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
 	INIT_LIST_HEAD(&p->se.group_node);
 
 #ifdef CONFIG_SCHEDSTATS
@@ -1929,6 +1931,7 @@ prepare_task_switch(struct rq *rq, struct task_struct *prev,
 		    struct task_struct *next)
 {
 	sched_info_switch(prev, next);
+	cpufreq_task_stats_update(prev);
 	perf_event_task_sched_out(prev, next);
 	quadd_task_sched_out(prev, next);
 	fire_sched_out_preempt_notifiers(prev, next);
@@ -3194,6 +3197,23 @@ void thread_group_times(struct task_struct *p, cputime_t *ut, cputime_t *st)
 }
 #endif
 
+#ifdef CONFIG_CPU_FREQ
+DEFINE_PER_CPU(struct sched_load_hook *, sched_load_hook);
+
+/**
+ * sched_set_load_hook - install a cpufreq load change callback for a CPU
+ * @cpu: the CPU whose runqueue is watched
+ * @hook: the callback, or NULL to remove the current one
+ *
+ * A removed hook may still be running until synchronize_sched() returns.
+ */
+void sched_set_load_hook(int cpu, struct sched_load_hook *hook)
+{
+	rcu_assign_pointer(per_cpu(sched_load_hook, cpu), hook);
+}
+EXPORT_SYMBOL_GPL(sched_set_load_hook);
+#endif
+
 /*
  * This function gets called by the timer code, with HZ frequency.
  * We call it with interrupts disabled.
@@ -3209,9 +3229,12 @@ void scheduler_tick(void)
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
+	update_rq_util(rq, curr != rq->idle);
 	curr->sched_class->task_tick(rq, curr, 0);
+	cpufreq_task_stats_update(curr);
 	raw_spin_unlock(&rq->lock);
 
+	sched_load_changed(rq, SCHED_LOAD_TICK);
 	perf_event_task_tick();
 
 #ifdef CONFIG_SMP
@@ -5811,7 +5834,8 @@ static int sd_degenerate(struct sched_domain *sd)
 			 SD_BALANCE_FORK |
 			 SD_BALANCE_EXEC |
 			 SD_SHARE_CPUPOWER |
-			 SD_SHARE_PKG_RESOURCES)) {
+			 SD_SHARE_PKG_RESOURCES |
+			 SD_SHARE_POWERDOMAIN)) {
 		if (sd->groups != sd->groups->next)
 			return 0;
 	}
@@ -5841,7 +5865,8 @@ sd_parent_degenerate(struct sched_domain *sd, struct sched_domain *parent)
 				SD_BALANCE_FORK |
 				SD_BALANCE_EXEC |
 				SD_SHARE_CPUPOWER |
-				SD_SHARE_PKG_RESOURCES);
+				SD_SHARE_PKG_RESOURCES |
+				SD_SHARE_POWERDOMAIN);
 		if (nr_node_ids == 1)
 			pflags &= ~SD_SERIALIZE;
 	}
@@ -6025,6 +6050,29 @@ static void update_top_cache_domain(int cpu)
 	per_cpu(sd_llc_id, cpu) = id;
 }
 
+/*
+ * Light tasks waking on a CPU are packed onto its buddy: the first CPU
+ * of the lowest domain whose members can be powered down on their own.
+ * -1 if every level shares a power domain, and packing would save
+ * nothing.
+ */
+DEFINE_PER_CPU(int, sd_pack_buddy);
+
+static void update_pack_buddy(int cpu)
+{
+	struct sched_domain *sd;
+	int buddy = -1;
+
+	for_each_domain(cpu, sd) {
+		if (!(sd->flags & SD_SHARE_POWERDOMAIN)) {
+			buddy = cpumask_first(sched_domain_span(sd));
+			break;
+		}
+	}
+
+	per_cpu(sd_pack_buddy, cpu) = buddy;
+}
+
 /*
  * Attach the domain 'sd' to 'cpu' as its base domain. Callers must
  * hold the hotplug lock.
@@ -6066,6 +6114,7 @@ cpu_attach_domain(struct sched_domain *sd, struct root_domain *rd, int cpu)
 	destroy_sched_domains(tmp, cpu);
 
 	update_top_cache_domain(cpu);
+	update_pack_buddy(cpu);
 }
 
 /* cpus with isolated domains */
@@ -6371,6 +6420,11 @@ int __weak arch_sd_sibling_asym_packing(void)
        return 0*SD_ASYM_PACKING;
 }
 
+int __weak arch_sd_share_power_domain(void)
+{
+	return 1*SD_SHARE_POWERDOMAIN;
+}
+
 /*
  * Initializers for schedule domains
  * Non-inlined to reduce accumulated stack pressure in build_sched_domains()
@@ -279,6 +279,8 @@ static void print_cpu(struct seq_file *m, int cpu)
 	P(cpu_load[2]);
 	P(cpu_load[3]);
 	P(cpu_load[4]);
+	P(avg.util);
+	P(util_demand);
 #undef P
 #undef PN
 
@@ -423,6 +425,7 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	PN(se.exec_start);
 	PN(se.vruntime);
 	PN(se.sum_exec_runtime);
+	P(se.avg.util);
 
 	nr_switches = p->nvcsw + p->nivcsw;
 
@@ -26,6 +26,7 @@
 #include <linux/slab.h>
 #include <linux/profile.h>
 #include <linux/interrupt.h>
+#include <linux/export.h>
 
 #include <trace/events/sched.h>
 
@@ -800,6 +801,239 @@ account_entity_dequeue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	cfs_rq->nr_running--;
 }
 
+/*
+ * Per-entity load tracking.
+ *
+ * Time is accounted in 1024us periods.  Each period counts y times as
+ * much as the one after it, with y^32 = 1/2, so what a task did 32ms ago
+ * weighs half as much as what it is doing now.  Only tasks are tracked,
+ * along with the busy time of each rq; nothing in load balancing uses
+ * this yet, it is there for cpufreq and other consumers of
+ * sched_cpu_util() and friends.
+ */
+#define LOAD_AVG_PERIOD	32
+#define LOAD_AVG_MAX	47742	/* maximum possible sum */
+#define LOAD_AVG_MAX_N	345	/* periods for the sum to reach LOAD_AVG_MAX */
+
+/* y^n in 0.32 fixed point, for n in [0, LOAD_AVG_PERIOD) */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b, 0xeac0c6e7, 0xe5b906e7,
+	0xe0ccdeec, 0xdbfbb797, 0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47, 0xb504f333, 0xb123f581,
+	0xad583eea, 0xa9a15ab4, 0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/* sum of 1024 * y^k for k in [1, n] */
+static const u32 runnable_avg_yN_sum[] = {
+	    0, 1002, 1982, 2941, 3880, 4798, 5697, 6576, 7437, 8279, 9103,
+	 9909,10698,11470,12226,12965,13689,14397,15090,15768,16431,17080,
+	17715,18337,18945,19540,20123,20693,21251,21797,22331,22854,23365,
+};
+
+/* val * y^n */
+static __always_inline u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	local_n = n;
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	return val >> 32;
+}
+
+/* sum of 1024 * y^k for k in [1, n], i.e. n full periods just gone by */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	/* each LOAD_AVG_PERIOD halves what came before it */
+	do {
+		contrib /= 2;
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Account the time from sa->last_update to @now, all of it spent
+ * running or not according to @running.  Returns 1 if a period boundary
+ * was crossed, i.e. the sums were decayed and the average has moved.
+ */
+static int __update_sched_avg(u64 now, struct sched_avg *sa, int running)
+{
+	u64 delta, periods;
+	u32 contrib;
+	unsigned int delta_w;
+	int decayed = 0;
+
+	delta = now - sa->last_update;
+	/*
+	 * First update, or the clock went backwards (a task that moved to
+	 * a CPU whose clock is behind): start over from here.
+	 */
+	if (!sa->last_update || (s64)delta < 0) {
+		sa->last_update = now;
+		return 0;
+	}
+
+	/* use 1024ns as the unit, and 1024 units as the period */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_update += delta << 10;
+
+	/* finish the current period first */
+	delta_w = sa->period % 1024;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		delta_w = 1024 - delta_w;
+		if (running)
+			sa->running_sum += delta_w;
+		sa->period += delta_w;
+		delta -= delta_w;
+
+		/* then the full periods since, and the new partial one */
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->running_sum = decay_load(sa->running_sum, periods + 1);
+		sa->period = decay_load(sa->period, periods + 1);
+
+		contrib = __compute_runnable_contrib(periods);
+		if (running)
+			sa->running_sum += contrib;
+		sa->period += contrib;
+	}
+
+	if (running)
+		sa->running_sum += delta;
+	sa->period += delta;
+
+	return decayed;
+}
+
+static inline unsigned long __sched_avg_util(struct sched_avg *sa)
+{
+	return (sa->running_sum << SCHED_UTIL_SHIFT) / (sa->period + 1);
+}
+
+/*
+ * Bring a task's average up to date, using whether it is the current
+ * entity of its cfs_rq to tell running from waiting or sleeping, and
+ * keep the rq's demand in step while it is queued.
+ */
+static void update_entity_util(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	unsigned long util;
+
+	if (!entity_is_task(se))
+		return;
+
+	if (!__update_sched_avg(rq->clock_task, &se->avg, cfs_rq->curr == se))
+		return;
+
+	util = __sched_avg_util(&se->avg);
+	if (se->on_rq)
+		rq->util_demand += util - se->avg.util;
+	se->avg.util = util;
+}
+
+static void enqueue_entity_util(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	update_entity_util(cfs_rq, se);
+	if (entity_is_task(se))
+		rq_of(cfs_rq)->util_demand += se->avg.util;
+}
+
+static void dequeue_entity_util(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	update_entity_util(cfs_rq, se);
+	if (entity_is_task(se))
+		rq_of(cfs_rq)->util_demand -= se->avg.util;
+}
+
+/* Called with rq->lock held when the CPU goes idle or busy, and at the tick */
+void update_rq_util(struct rq *rq, int busy)
+{
+	if (__update_sched_avg(rq->clock, &rq->avg, busy))
+		rq->avg.util = __sched_avg_util(&rq->avg);
+}
+
+/**
+ * sched_cpu_util - decayed busy time of a CPU
+ * @cpu: the CPU
+ *
+ * Returns how busy @cpu has recently been, from 0 to SCHED_UTIL_SCALE.
+ * Unlike idle-time sampling this needs no window of its own, and it is
+ * up to date at the time of the call.
+ */
+unsigned long sched_cpu_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	struct sched_avg avg;
+	unsigned long flags;
+	int busy;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	avg = rq->avg;
+	busy = rq->curr != rq->idle;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	/* it has been busy, or idle, ever since the last update */
+	__update_sched_avg(cpu_clock(cpu), &avg, busy);
+
+	return __sched_avg_util(&avg);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_util);
+
+/**
+ * sched_cpu_demand - utilisation of the tasks queued on a CPU
+ * @cpu: the CPU
+ *
+ * Returns the sum of sched_task_util() over the fair tasks queued on
+ * @cpu.  Above SCHED_UTIL_SCALE the CPU cannot keep up with them at its
+ * current speed.
+ */
+unsigned long sched_cpu_demand(int cpu)
+{
+	return ACCESS_ONCE(cpu_rq(cpu)->util_demand);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_demand);
+
+/**
+ * sched_task_util - decayed running time of a task
+ * @p: the task
+ *
+ * Returns the share of recent time @p spent running, from 0 to
+ * SCHED_UTIL_SCALE, as of the last time it was scheduled or ticked.
+ */
+unsigned long sched_task_util(struct task_struct *p)
+{
+	return ACCESS_ONCE(p->se.avg.util);
+}
+EXPORT_SYMBOL_GPL(sched_task_util);
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 /* we need this in update_cfs_load and load-balance functions below */
 static inline int throttled_hierarchy(struct cfs_rq *cfs_rq);
@@ -1103,6 +1337,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 */
 	update_curr(cfs_rq);
 	update_cfs_load(cfs_rq, 0);
+	enqueue_entity_util(cfs_rq, se);
 	account_entity_enqueue(cfs_rq, se);
 	update_cfs_shares(cfs_rq);
 
@@ -1177,6 +1412,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	dequeue_entity_util(cfs_rq, se);
 
 	update_stats_dequeue(cfs_rq, se);
 	if (flags & DEQUEUE_SLEEP) {
@@ -1269,6 +1505,8 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		__dequeue_entity(cfs_rq, se);
 	}
 
+	/* waited until now */
+	update_entity_util(cfs_rq, se);
 	update_stats_curr_start(cfs_rq, se);
 	cfs_rq->curr = se;
 #ifdef CONFIG_SCHEDSTATS
@@ -1338,6 +1576,9 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 	if (prev->on_rq)
 		update_curr(cfs_rq);
 
+	/* ran until now */
+	update_entity_util(cfs_rq, prev);
+
 	/* throttle cfs_rqs exceeding runtime */
 	check_cfs_rq_runtime(cfs_rq);
 
@@ -1357,6 +1598,7 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	update_entity_util(cfs_rq, curr);
 
 	/*
 	 * Update share accounting for long-running entities.
@@ -2220,6 +2462,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	if (!se)
 		inc_nr_running(rq);
 	hrtick_update(rq);
+	sched_load_changed(rq, SCHED_LOAD_ENQUEUE);
 }
 
 static void set_next_buddy(struct sched_entity *se);
@@ -2687,6 +2930,92 @@ done:
 	return target;
 }
 
+/*
+ * Small task packing.  Light tasks are woken on their CPU's pack buddy
+ * (see update_pack_buddy()) instead of being spread out, and the other
+ * CPUs do not pull work while the buddy copes and the busiest group is
+ * lightly loaded, so that they stay idle long enough to be power gated
+ * or taken offline.  A task is light below
+ * sched_pack_task_pct percent of a CPU; the buddy copes while its
+ * utilisation stays below sched_pack_cpu_pct.
+ */
+unsigned int sysctl_sched_packing = 1;
+unsigned int sysctl_sched_pack_task_pct = 25;
+unsigned int sysctl_sched_pack_cpu_pct = 75;
+
+static inline unsigned long pack_pct_to_util(unsigned int pct)
+{
+	return pct * SCHED_UTIL_SCALE / 100;
+}
+
+static unsigned long pack_cpu_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	/* no lock: a stale value only makes one decision less accurate */
+	return max(ACCESS_ONCE(rq->avg.util), ACCESS_ONCE(rq->util_demand));
+}
+
+static int pack_buddy_copes(int buddy, unsigned long extra)
+{
+	return pack_cpu_util(buddy) + extra <
+		pack_pct_to_util(sysctl_sched_pack_cpu_pct);
+}
+
+/* The CPU to wake @p on to pack it, or -1 */
+static int check_pack_buddy(int cpu, struct task_struct *p)
+{
+	int buddy = per_cpu(sd_pack_buddy, cpu);
+	unsigned long util;
+
+	if (!sysctl_sched_packing || buddy < 0)
+		return -1;
+
+	if (!cpumask_test_cpu(buddy, tsk_cpus_allowed(p)))
+		return -1;
+
+	util = sched_task_util(p);
+	if (util >= pack_pct_to_util(sysctl_sched_pack_task_pct))
+		return -1;
+
+	if (!pack_buddy_copes(buddy, util))
+		return -1;
+
+	return buddy;
+}
+
+/*
+ * Whether @this_cpu should leave the tasks in @busiest to its pack buddy.
+ * Only while the buddy copes and every other CPU of the group is lightly
+ * loaded: below the pack threshold or running at most one task.  Anything
+ * heavier is a real imbalance and gets balanced as usual.
+ */
+static int pack_skip_balance(int this_cpu, struct sched_domain *sd,
+			     struct sched_group *busiest)
+{
+	int buddy = per_cpu(sd_pack_buddy, this_cpu);
+	unsigned long thresh = pack_pct_to_util(sysctl_sched_pack_cpu_pct);
+	int cpu;
+
+	if (!sysctl_sched_packing || buddy < 0 || buddy == this_cpu)
+		return 0;
+
+	if (!cpumask_test_cpu(buddy, sched_domain_span(sd)))
+		return 0;
+
+	if (!pack_buddy_copes(buddy, 0))
+		return 0;
+
+	for_each_cpu(cpu, sched_group_cpus(busiest)) {
+		if (cpu == buddy)
+			continue;
+		if (cpu_rq(cpu)->nr_running > 1 && pack_cpu_util(cpu) >= thresh)
+			return 0;
+	}
+
+	return 1;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -2713,6 +3042,11 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 		return prev_cpu;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
+		int buddy = check_pack_buddy(prev_cpu, p);
+
+		if (buddy >= 0)
+			return buddy;
+
 		if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
 			want_affine = 1;
 		new_cpu = prev_cpu;
@@ -4434,6 +4768,10 @@ redo:
 		goto out_balanced;
 	}
 
+	/* newly idle or not, leave light work to the pack buddy */
+	if (pack_skip_balance(this_cpu, sd, group))
+		goto out_balanced;
+
 	busiest = find_busiest_queue(sd, group, idle, imbalance, cpus);
 	if (!busiest) {
 		schedstat_inc(sd, lb_nobusyq[idle]);
@@ -25,6 +25,8 @@ static void check_preempt_curr_idle(struct rq *rq, struct task_struct *p, int fl
 static struct task_struct *pick_next_task_idle(struct rq *rq)
 {
 	schedstat_inc(rq, sched_goidle);
+	/* busy until now */
+	update_rq_util(rq, 1);
 	return rq->idle;
 }
 
@@ -43,6 +45,8 @@ dequeue_task_idle(struct rq *rq, struct task_struct *p, int flags)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	/* idle until now */
+	update_rq_util(rq, 0);
 }
 
 static void task_tick_idle(struct rq *rq, struct task_struct *curr, int queued)
@@ -368,6 +368,10 @@ struct rq {
 	u64 nr_running_integral;
 	seqcount_t ave_seqcnt;
 
+	/* decayed busy time, and the utilisation of the queued fair tasks */
+	struct sched_avg avg;
+	unsigned long util_demand;
+
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
 	unsigned long nr_load_updates;
@@ -530,6 +534,7 @@ static inline struct sched_domain *highest_flag_domain(int cpu, int flag)
 
 DECLARE_PER_CPU(struct sched_domain *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_id);
+DECLARE_PER_CPU(int, sd_pack_buddy);
 
 #endif /* CONFIG_SMP */
 
@@ -954,7 +959,27 @@ static inline void dec_nr_running(struct rq *rq)
 	write_seqcount_end(&rq->ave_seqcnt);
 }
 
+#ifdef CONFIG_CPU_FREQ
+DECLARE_PER_CPU(struct sched_load_hook *, sched_load_hook);
+
+/*
+ * Tell the cpufreq governor, if it asked for it, that the load of
+ * this runqueue may have changed.
+ */
+static inline void sched_load_changed(struct rq *rq, int event)
+{
+	struct sched_load_hook *hook;
+
+	hook = rcu_dereference_sched(per_cpu(sched_load_hook, cpu_of(rq)));
+	if (hook)
+		hook->func(hook, cpu_of(rq), rq->nr_running, rq->clock, event);
+}
+#else
+static inline void sched_load_changed(struct rq *rq, int event) { }
+#endif
+
 extern void update_rq_clock(struct rq *rq);
+extern void update_rq_util(struct rq *rq, int busy);
 
 extern void activate_task(struct rq *rq, struct task_struct *p, int flags);
 extern void deactivate_task(struct rq *rq, struct task_struct *p, int flags);
@@ -0,0 +1,129 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Implements the LZ4 block format designed by Yann Collet.
+ * See http://code.google.com/p/lz4/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/lz4.h>
+#include <linux/string.h>
+#include "lz4defs.h"
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)len;
+
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *hash_table = wrkmem;
+	const unsigned char *ip = src, *anchor = src, *ref;
+	const unsigned char * const iend = src + src_len;
+	const unsigned char * const mflimit = iend - MFLIMIT;
+	const unsigned char * const matchlimit = iend - LASTLITERALS;
+	unsigned char *op = dst, *token;
+	unsigned int attempts;
+	size_t len;
+	u32 h;
+
+	memset(hash_table, 0, LZ4_MEM_COMPRESS);
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	hash_table[LZ4_HASH(ip)] = 0;
+	ip++;
+
+	while (ip <= mflimit) {
+		/* Find a match, skipping faster the longer we miss */
+		attempts = 1 << SKIP_STRENGTH;
+		for (;;) {
+			h = LZ4_HASH(ip);
+			ref = src + hash_table[h];
+			hash_table[h] = ip - src;
+			if (ip - ref <= MAX_DISTANCE &&
+			    LZ4_READ32(ref) == LZ4_READ32(ip))
+				break;
+			ip += attempts++ >> SKIP_STRENGTH;
+			if (ip > mflimit)
+				goto last_literals;
+		}
+
+		/* Catch up with bytes that also match before ip */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* Encode literal length */
+		len = ip - anchor;
+		token = op++;
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else {
+			*token = len << ML_BITS;
+		}
+
+		/* Copy literals */
+		memcpy(op, anchor, len);
+		op += len;
+
+		/* Encode offset */
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		/* Count the match length past MINMATCH */
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		len = ip - anchor;
+		if (len >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else {
+			*token |= len;
+		}
+		anchor = ip;
+
+		if (ip > mflimit)
+			break;
+
+		/* Fill the table with a position from inside the match */
+		hash_table[LZ4_HASH(ip - 2)] = ip - 2 - src;
+	}
+
+last_literals:
+	len = iend - anchor;
+	if (len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*op++ = len << ML_BITS;
+	}
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
@@ -0,0 +1,108 @@
+/*
+ * LZ4 Decompressor for Linux kernel
+ *
+ * Implements the LZ4 block format designed by Yann Collet.
+ * See http://code.google.com/p/lz4/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+#include <linux/lz4.h>
+#include <linux/string.h>
+#include "lz4defs.h"
+
+/*
+ * Read a length extension: a run of 255 bytes terminated by a byte < 255,
+ * all added to the 4-bit length from the token.
+ */
+static inline int lz4_get_length(const unsigned char **ip,
+		const unsigned char *iend, size_t *len)
+{
+	unsigned int s;
+
+	do {
+		if (unlikely(*ip >= iend))
+			return -1;
+		s = *(*ip)++;
+		*len += s;
+	} while (s == 255);
+
+	return 0;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const unsigned char *ip = src, *ref;
+	const unsigned char * const iend = src + src_len;
+	unsigned char *op = dest;
+	unsigned char * const oend = dest + *dest_len;
+	unsigned int token;
+	size_t len, offset;
+
+	if (unlikely(!src_len))
+		goto _output_error;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* Literals */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4_get_length(&ip, iend, &len))
+			goto _output_error;
+		if (unlikely(len > (size_t)(iend - ip) ||
+			     len > (size_t)(oend - op)))
+			goto _output_error;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* The last sequence carries literals only */
+		if (ip == iend)
+			break;
+
+		/* Match */
+		if (unlikely(iend - ip < 2))
+			goto _output_error;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(!offset || offset > (size_t)(op - dest)))
+			goto _output_error;
+		ref = op - offset;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4_get_length(&ip, iend, &len))
+			goto _output_error;
+		len += MINMATCH;
+		if (unlikely(len > (size_t)(oend - op)))
+			goto _output_error;
+
+		if (offset >= len) {
+			memcpy(op, ref, len);
+			op += len;
+		} else {
+			/* Overlapping copy repeats the last offset bytes */
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+	/* write overflow error detected */
+_output_error:
+	return -1;
+}
+#ifndef STATIC
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
@@ -0,0 +1,36 @@
+/*
+ * lz4defs.h -- LZ4 block format constants and helpers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/unaligned.h>
+
+#define MINMATCH	4
+
+/* The last match must start at least MFLIMIT bytes before the end */
+#define MFLIMIT		12
+/* The last LASTLITERALS bytes of a block are always literals */
+#define LASTLITERALS	5
+
+#define MAX_DISTANCE	65535
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define LZ4_HASH_LOG	12
+#define LZ4_HASH_SIZE	(1 << LZ4_HASH_LOG)
+
+/*
+ * Increase the skip step after this many failed match attempts
+ * (1 << SKIP_STRENGTH), so incompressible data is scanned faster.
+ */
+#define SKIP_STRENGTH	6
+
+#define LZ4_READ32(p)	get_unaligned((const u32 *)(p))
+#define LZ4_HASH(p)	((LZ4_READ32(p) * 2654435761U) >> \
+				(32 - LZ4_HASH_LOG))
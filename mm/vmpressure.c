@@ -0,0 +1,330 @@
+/*
+ * mm/vmpressure.c
+ *
+ * Memory pressure notifications based on reclaim efficiency.
+ *
+ * Reclaim reports how many pages it scanned and how many of them it
+ * managed to reclaim. Once a window of scanned pages is complete, the
+ * ratio of the two is turned into a pressure level:
+ *
+ *  low      - reclaim is keeping up; a good time to drop caches
+ *  medium   - reclaim struggles; swapping or evicting working set
+ *  critical - reclaim barely makes progress; the OOM killer is near
+ *
+ * Userspace opens /proc/vmpressure, optionally writes the lowest level
+ * it cares about ("low" by default), and polls the fd. Reading returns
+ * the highest level seen since the previous read, along with the pages
+ * scanned and reclaimed in that window, e.g. "medium 512 143".
+ *
+ * Released under the GPL, see the file COPYING for details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/log2.h>
+#include <linux/poll.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/swap.h>
+#include <linux/uaccess.h>
+#include <linux/vmpressure.h>
+#include <linux/wait.h>
+
+/*
+ * Pages scanned before the pressure is computed. Smaller windows react
+ * faster but are noisier. 512 pages (2MB with 4K pages) is as many as
+ * reclaim scans at its highest priority.
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+/* Pressure, in percent of scanned pages not reclaimed, for each level */
+static const unsigned int vmpressure_level_med = 60;
+static const unsigned int vmpressure_level_critical = 95;
+
+/*
+ * Reclaim dropping to this priority means it had to scan 1/8th of the
+ * LRUs without freeing enough, which is treated as critical.
+ */
+static const int vmpressure_level_critical_prio = ilog2(100 / 10);
+
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+static const char * const vmpressure_str_levels[] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+struct vmpressure_event {
+	unsigned long seq;	/* vmpressure_seq of the last event */
+	unsigned long scanned;
+	unsigned long reclaimed;
+};
+
+/* All of the state below is protected by vmpressure_lock */
+static DEFINE_SPINLOCK(vmpressure_lock);
+static unsigned long vmpressure_scanned;
+static unsigned long vmpressure_reclaimed;
+static unsigned long vmpressure_seq;
+static struct vmpressure_event vmpressure_events[VMPRESSURE_NUM_LEVELS];
+static DECLARE_WAIT_QUEUE_HEAD(vmpressure_wait);
+
+/* Per open file */
+struct vmpressure_listener {
+	enum vmpressure_levels level;	/* lowest level of interest */
+	unsigned long seq;		/* vmpressure_seq at the last read */
+};
+
+static enum vmpressure_levels vmpressure_level(unsigned long pressure)
+{
+	if (pressure >= vmpressure_level_critical)
+		return VMPRESSURE_CRITICAL;
+	else if (pressure >= vmpressure_level_med)
+		return VMPRESSURE_MEDIUM;
+	return VMPRESSURE_LOW;
+}
+
+static enum vmpressure_levels vmpressure_calc_level(unsigned long scanned,
+						    unsigned long reclaimed)
+{
+	unsigned long scale = scanned + reclaimed;
+	unsigned long pressure;
+
+	/*
+	 * reclaimed can exceed scanned, e.g. when reclaim frees more than
+	 * one page per scanned page, which would wrap the calculation
+	 * below into a false critical.  Report that as no pressure.
+	 */
+	if (reclaimed >= scanned)
+		return VMPRESSURE_LOW;
+
+	/*
+	 * We calculate the ratio (in percents) of how many pages were
+	 * scanned vs. reclaimed in a given time frame (window). Note that
+	 * time is in VM reclaimer's "ticks", i.e. number of pages
+	 * scanned. This makes it possible to set desired reaction time
+	 * and serves as a ratelimit.
+	 */
+	pressure = scale - (reclaimed * scale / scanned);
+	pressure = pressure * 100 / scale;
+
+	pr_debug("%s: %3lu  (s: %lu  r: %lu)\n", __func__, pressure,
+		 scanned, reclaimed);
+
+	return vmpressure_level(pressure);
+}
+
+/**
+ * vmpressure() - Account memory pressure through scanned/reclaimed ratio
+ * @gfp:	reclaimer's gfp mask
+ * @scanned:	number of pages scanned
+ * @reclaimed:	number of pages reclaimed
+ *
+ * Called by reclaim after each zone is shrunk. Listeners are woken up
+ * once vmpressure_win pages have been scanned.
+ */
+void vmpressure(gfp_t gfp, unsigned long scanned, unsigned long reclaimed)
+{
+	enum vmpressure_levels level;
+	struct vmpressure_event *ev;
+
+	/*
+	 * Only count allocations that could have gotten their pages
+	 * elsewhere: reclaim for, say, a GFP_NOIO request says little
+	 * about the state of the system as a whole.
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	/*
+	 * If we got here with no pages scanned, then that is an indicator
+	 * that reclaimer was unable to find any shrinkable LRUs at the
+	 * current scanning depth. But it does not mean that we should
+	 * report the critical pressure, yet.
+	 */
+	if (!scanned)
+		return;
+
+	spin_lock(&vmpressure_lock);
+	vmpressure_scanned += scanned;
+	vmpressure_reclaimed += reclaimed;
+	if (vmpressure_scanned < vmpressure_win) {
+		spin_unlock(&vmpressure_lock);
+		return;
+	}
+
+	level = vmpressure_calc_level(vmpressure_scanned,
+				      vmpressure_reclaimed);
+	ev = &vmpressure_events[level];
+	ev->seq = ++vmpressure_seq;
+	ev->scanned = vmpressure_scanned;
+	ev->reclaimed = vmpressure_reclaimed;
+	vmpressure_scanned = 0;
+	vmpressure_reclaimed = 0;
+	spin_unlock(&vmpressure_lock);
+
+	wake_up_interruptible(&vmpressure_wait);
+}
+
+/**
+ * vmpressure_prio() - Account memory pressure through reclaimer priority level
+ * @gfp:	reclaimer's gfp mask
+ * @prio:	reclaimer's priority
+ *
+ * Reclaim getting down to vmpressure_level_critical_prio is reported
+ * as critical pressure right away, whatever the current window says.
+ */
+void vmpressure_prio(gfp_t gfp, int prio)
+{
+	if (prio > vmpressure_level_critical_prio)
+		return;
+
+	/* A full window with nothing reclaimed gives critical pressure */
+	vmpressure(gfp, vmpressure_win, 0);
+}
+
+/* vmpressure_lock should be held */
+static int vmpressure_pending(struct vmpressure_listener *vl)
+{
+	int level;
+
+	for (level = VMPRESSURE_NUM_LEVELS - 1; level >= (int)vl->level;
+	     level--) {
+		if (vmpressure_events[level].seq > vl->seq)
+			return level;
+	}
+	return -1;
+}
+
+static bool vmpressure_has_event(struct vmpressure_listener *vl)
+{
+	bool ret;
+
+	spin_lock(&vmpressure_lock);
+	ret = vmpressure_pending(vl) >= 0;
+	spin_unlock(&vmpressure_lock);
+
+	return ret;
+}
+
+static int vmpressure_open(struct inode *inode, struct file *file)
+{
+	struct vmpressure_listener *vl;
+
+	vl = kzalloc(sizeof(*vl), GFP_KERNEL);
+	if (!vl)
+		return -ENOMEM;
+
+	vl->level = VMPRESSURE_LOW;
+	spin_lock(&vmpressure_lock);
+	vl->seq = vmpressure_seq;
+	spin_unlock(&vmpressure_lock);
+
+	file->private_data = vl;
+	return nonseekable_open(inode, file);
+}
+
+static int vmpressure_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t vmpressure_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct vmpressure_listener *vl = file->private_data;
+	struct vmpressure_event ev;
+	unsigned long seq;
+	char line[64];
+	int level, len, ret;
+
+	spin_lock(&vmpressure_lock);
+	while ((level = vmpressure_pending(vl)) < 0) {
+		spin_unlock(&vmpressure_lock);
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(vmpressure_wait,
+					       vmpressure_has_event(vl));
+		if (ret)
+			return ret;
+		spin_lock(&vmpressure_lock);
+	}
+	ev = vmpressure_events[level];
+	seq = vmpressure_seq;
+	spin_unlock(&vmpressure_lock);
+
+	len = snprintf(line, sizeof(line), "%s %lu %lu\n",
+		       vmpressure_str_levels[level], ev.scanned, ev.reclaimed);
+	if (count < len)
+		return -EINVAL;
+	if (copy_to_user(buf, line, len))
+		return -EFAULT;
+
+	/* only consume the event once it has been delivered */
+	spin_lock(&vmpressure_lock);
+	if (seq > vl->seq)
+		vl->seq = seq;
+	spin_unlock(&vmpressure_lock);
+	return len;
+}
+
+static ssize_t vmpressure_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct vmpressure_listener *vl = file->private_data;
+	char level[16];
+	int i;
+
+	if (count >= sizeof(level))
+		return -EINVAL;
+	if (copy_from_user(level, buf, count))
+		return -EFAULT;
+	level[count] = '\0';
+
+	for (i = 0; i < VMPRESSURE_NUM_LEVELS; i++) {
+		if (sysfs_streq(level, vmpressure_str_levels[i])) {
+			vl->level = i;
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+
+static unsigned int vmpressure_poll(struct file *file, poll_table *wait)
+{
+	struct vmpressure_listener *vl = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &vmpressure_wait, wait);
+	if (vmpressure_has_event(vl))
+		mask = POLLIN | POLLRDNORM | POLLPRI;
+
+	return mask;
+}
+
+static const struct file_operations proc_vmpressure_operations = {
+	.open		= vmpressure_open,
+	.read		= vmpressure_read,
+	.write		= vmpressure_write,
+	.poll		= vmpressure_poll,
+	.release	= vmpressure_release,
+	.llseek		= no_llseek,
+};
+
+static int __init vmpressure_init(void)
+{
+	proc_create("vmpressure", S_IRUGO | S_IWUGO, NULL,
+		    &proc_vmpressure_operations);
+	return 0;
+}
+module_init(vmpressure_init);
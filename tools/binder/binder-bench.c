@@ -0,0 +1,288 @@
+/*
+ * binder-bench: measure binder transaction round trip latency
+ *
+ * The parent registers itself as the binder context manager and echoes
+ * every transaction it receives; a forked client sends synchronous
+ * transactions to handle 0 for a range of payload sizes and reports the
+ * round trip rate and latency for each.  servicemanager must be stopped
+ * first, since only one context manager can exist at a time.
+ *
+ * Usage: binder-bench [-d /dev/binder] [-n iterations]
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../drivers/staging/android/binder.h"
+
+#define MAP_SIZE	((1 << 20) - 2 * 4096)
+#define CODE_ECHO	1
+#define CODE_QUIT	2
+
+static const char *dev = "/dev/binder";
+static const size_t sizes[] = { 16, 64, 128, 256, 512, 4096, 16384 };
+static char payload[16384];
+
+struct binder {
+	int fd;
+	void *map;
+};
+
+static int binder_open(struct binder *b)
+{
+	b->fd = open(dev, O_RDWR);
+	if (b->fd < 0) {
+		perror(dev);
+		return -1;
+	}
+	b->map = mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0);
+	if (b->map == MAP_FAILED) {
+		perror("mmap");
+		close(b->fd);
+		return -1;
+	}
+	return 0;
+}
+
+static int binder_write_read(struct binder *b, void *wbuf, size_t wsize,
+			     void *rbuf, size_t rsize, size_t *consumed)
+{
+	struct binder_write_read bwr;
+	int ret;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.write_size = wsize;
+	bwr.read_buffer = (unsigned long)rbuf;
+	bwr.read_size = rsize;
+	do {
+		ret = ioctl(b->fd, BINDER_WRITE_READ, &bwr);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		perror("BINDER_WRITE_READ");
+		return -1;
+	}
+	if (consumed)
+		*consumed = bwr.read_consumed;
+	return 0;
+}
+
+/* Queue a BC_FREE_BUFFER for buf followed by a transaction or reply */
+static size_t build_cmds(uint8_t *out, const void *free_buf, uint32_t cmd,
+			 unsigned int code, size_t size)
+{
+	struct binder_transaction_data tr;
+	size_t len = 0;
+	uint32_t c;
+
+	if (free_buf) {
+		c = BC_FREE_BUFFER;
+		memcpy(out + len, &c, sizeof(c));
+		len += sizeof(c);
+		memcpy(out + len, &free_buf, sizeof(free_buf));
+		len += sizeof(free_buf);
+	}
+
+	memset(&tr, 0, sizeof(tr));
+	tr.target.handle = 0;
+	tr.code = code;
+	tr.data_size = size;
+	tr.data.ptr.buffer = payload;
+	memcpy(out + len, &cmd, sizeof(cmd));
+	len += sizeof(cmd);
+	memcpy(out + len, &tr, sizeof(tr));
+	len += sizeof(tr);
+	return len;
+}
+
+/*
+ * Parse the read buffer until a BR_TRANSACTION or BR_REPLY (want) shows
+ * up.  Returns 1 with *tr filled in, 0 if more reads are needed, or -1 on
+ * a failed transaction.
+ */
+static int parse(uint8_t *buf, size_t len, uint32_t want,
+		 struct binder_transaction_data *tr)
+{
+	size_t pos = 0;
+	uint32_t cmd;
+
+	while (pos + sizeof(cmd) <= len) {
+		memcpy(&cmd, buf + pos, sizeof(cmd));
+		pos += sizeof(cmd);
+		if (cmd == want) {
+			memcpy(tr, buf + pos, sizeof(*tr));
+			return 1;
+		}
+		switch (cmd) {
+		case BR_NOOP:
+		case BR_TRANSACTION_COMPLETE:
+		case BR_SPAWN_LOOPER:
+			break;
+		case BR_DEAD_REPLY:
+		case BR_FAILED_REPLY:
+			fprintf(stderr, "transaction failed (0x%x)\n", cmd);
+			return -1;
+		default:
+			fprintf(stderr, "unexpected command 0x%x\n", cmd);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int wait_for(struct binder *b, uint8_t *wbuf, size_t wlen,
+		    uint32_t want, struct binder_transaction_data *tr)
+{
+	uint8_t rbuf[256];
+	size_t consumed;
+	int ret;
+
+	do {
+		if (binder_write_read(b, wbuf, wlen, rbuf, sizeof(rbuf),
+				      &consumed))
+			return -1;
+		wlen = 0;
+		ret = parse(rbuf, consumed, want, tr);
+	} while (ret == 0);
+	return ret < 0 ? -1 : 0;
+}
+
+static int server(struct binder *b)
+{
+	struct binder_transaction_data tr;
+	uint8_t wbuf[128];
+	size_t wlen;
+	uint32_t cmd = BC_ENTER_LOOPER;
+	const void *pending = NULL;
+	unsigned int code;
+
+	if (binder_write_read(b, &cmd, sizeof(cmd), NULL, 0, NULL))
+		return 1;
+
+	wlen = 0;
+	for (;;) {
+		if (wait_for(b, wbuf, wlen, BR_TRANSACTION, &tr))
+			return 1;
+		code = tr.code;
+		pending = tr.data.ptr.buffer;
+		/* Echo the payload size back, freeing the request with it */
+		wlen = build_cmds(wbuf, pending, BC_REPLY, code, tr.data_size);
+		if (code == CODE_QUIT) {
+			binder_write_read(b, wbuf, wlen, NULL, 0, NULL);
+			return 0;
+		}
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int client(int iterations)
+{
+	struct binder b;
+	struct binder_transaction_data tr;
+	uint8_t wbuf[128];
+	const void *reply = NULL;
+	double start, t, lat, min, max, total;
+	size_t wlen;
+	unsigned int i, s;
+
+	if (binder_open(&b))
+		return 1;
+
+	printf("%8s %12s %10s %10s %10s\n",
+	       "bytes", "calls/s", "avg us", "min us", "max us");
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		min = 1e9;
+		max = 0;
+		start = now();
+		for (i = 0; i < (unsigned int)iterations; i++) {
+			t = now();
+			wlen = build_cmds(wbuf, reply, BC_TRANSACTION,
+					  CODE_ECHO, sizes[s]);
+			if (wait_for(&b, wbuf, wlen, BR_REPLY, &tr))
+				return 1;
+			reply = tr.data.ptr.buffer;
+			lat = now() - t;
+			if (lat < min)
+				min = lat;
+			if (lat > max)
+				max = lat;
+		}
+		total = now() - start;
+		printf("%8zu %12.0f %10.1f %10.1f %10.1f\n", sizes[s],
+		       iterations / total, total / iterations * 1e6,
+		       min * 1e6, max * 1e6);
+	}
+
+	wlen = build_cmds(wbuf, reply, BC_TRANSACTION, CODE_QUIT, 0);
+	if (wait_for(&b, wbuf, wlen, BR_REPLY, &tr))
+		return 1;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct binder b;
+	int iterations = 10000;
+	int opt, status;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d dev] [-n iterations]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (iterations < 1)
+		iterations = 1;
+
+	if (binder_open(&b))
+		return 1;
+	if (ioctl(b.fd, BINDER_SET_CONTEXT_MGR, 0) < 0) {
+		perror("BINDER_SET_CONTEXT_MGR (is servicemanager running?)");
+		return 1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0)
+		exit(client(iterations));
+
+	if (server(&b)) {
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+		return 1;
+	}
+	waitpid(pid, &status, 0);
+	return !WIFEXITED(status) || WEXITSTATUS(status);
+}
@@ -0,0 +1,62 @@
+#!/bin/sh
+#
+# Build cpuquiet-bench, push it and the workload scripts to a device over
+# adb, and print its comparison of the cpuquiet governors.
+#
+# cpuquiet only has a driver for Tegra, which QEMU does not emulate, so
+# unlike tools/sched/pack-qemu.sh this runs on the device itself.  The
+# device needs a root adb shell and CONFIG_CPUQUIET_GOVERNOR_PREDICTIVE.
+# Options are passed on to cpuquiet-bench; without any workload scripts
+# all of workloads/ are replayed.
+#
+# Usage: cpuquiet-adb.sh [cpuquiet-bench options] [script...]
+#
+# Environment: CROSS_COMPILE (arm-linux-gnueabi-), ADB (adb),
+#              DIR (/data/local/tmp/cpuquiet)
+#
+# Licensed under the terms of the GNU GPL License version 2
+
+set -e
+
+CROSS_COMPILE=${CROSS_COMPILE-arm-linux-gnueabi-}
+ADB=${ADB:-adb}
+DIR=${DIR:-/data/local/tmp/cpuquiet}
+
+SRC=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+${CROSS_COMPILE}gcc -Wall -O2 -static -o "$TMP/cpuquiet-bench" \
+	"$SRC/cpuquiet-bench.c" -lpthread
+
+$ADB shell mkdir -p "$DIR/workloads"
+$ADB push "$TMP/cpuquiet-bench" "$DIR/cpuquiet-bench" >/dev/null
+for w in "$SRC"/workloads/*; do
+	$ADB push "$w" "$DIR/workloads/" >/dev/null
+done
+
+# Options come first; anything after them is a local script path
+OPTS=
+while [ $# -gt 0 ]; do
+	case $1 in
+	-[gsai])
+		OPTS="$OPTS $1 $2"
+		shift 2
+		;;
+	*)
+		break
+		;;
+	esac
+done
+
+if [ $# -eq 0 ]; then
+	SCRIPTS="$DIR/workloads/*"
+else
+	SCRIPTS=
+	for w in "$@"; do
+		$ADB push "$w" "$DIR/workloads/" >/dev/null
+		SCRIPTS="$SCRIPTS $DIR/workloads/$(basename "$w")"
+	done
+fi
+
+$ADB shell "chmod 755 $DIR/cpuquiet-bench && $DIR/cpuquiet-bench$OPTS $SCRIPTS"
@@ -0,0 +1,408 @@
+/*
+ * cpuquiet-bench: compare cpuquiet governors on scripted workloads
+ *
+ * Replays each workload script once under every governor given with -g
+ * (balanced, runnable and predictive by default) and reports per
+ * governor and script:
+ *
+ *  - the average number of online CPUs, sampled from
+ *    /sys/devices/system/cpu/online every few milliseconds
+ *  - the ramp latency: for every phase that needs more CPUs than are
+ *    online when it starts, the time until enough of them are online
+ *  - how many bursts missed the end of their period
+ *  - a modelled energy: busy time at the active power, plus online idle
+ *    time at the idle power.  Offline CPUs cost nothing.
+ *
+ * A workload script has one phase per line:
+ *
+ *	<duration_ms> <threads> <duty%> [period_ms]
+ *
+ * Each of the threads does a burst of duty% of every period (16 ms by
+ * default).  Zero threads is an idle phase.  Lines starting with '#' are
+ * comments.  See workloads/ for examples.
+ *
+ * Must be run as root.  The original governor is restored at the end.
+ *
+ * Usage: cpuquiet-bench [-g gov,gov,...] [-s settle_ms] [-a active_mW]
+ *                       [-i idle_mW] script...
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GOVERNOR_FILE	"/sys/devices/system/cpu/cpuquiet/current_governor"
+#define ONLINE_FILE	"/sys/devices/system/cpu/online"
+#define MAX_CPUS	32
+#define MAX_PHASES	256
+#define MAX_THREADS	MAX_CPUS
+#define SAMPLE_US	2000
+
+struct phase {
+	int ms, threads, duty, period_ms;
+};
+
+struct script {
+	const char *name;
+	struct phase phase[MAX_PHASES];
+	int nr_phases;
+};
+
+struct worker {
+	pthread_t thread;
+	const struct phase *phase;
+	unsigned long bursts, missed;
+};
+
+static const char *default_governors = "balanced,runnable,predictive";
+static int settle_ms = 2000;
+static int active_mw = 1000, idle_mw = 100;
+static volatile int stop, sampling;
+
+/* ramp in progress and totals, shared with the sampler */
+static pthread_mutex_t ramp_lock = PTHREAD_MUTEX_INITIALIZER;
+static int want_cpus;
+static unsigned long long want_since, ramp_ns, ramp_max_ns;
+static unsigned long ramps;
+static unsigned long long online_ns;	/* CPU-ns online, sampler only */
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(unsigned long long t)
+{
+	struct timespec ts;
+
+	ts.tv_sec = t / 1000000000ULL;
+	ts.tv_nsec = t % 1000000000ULL;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void *burst(void *data)
+{
+	struct worker *w = data;
+	unsigned long long period = w->phase->period_ms * 1000000ULL;
+	unsigned long long work = period * w->phase->duty / 100;
+	unsigned long long next = now_ns();
+
+	while (!stop) {
+		unsigned long long end = now_ns() + work;
+
+		while (now_ns() < end && !stop)
+			;
+		w->bursts++;
+
+		next += period;
+		if (now_ns() > next) {
+			/* skip the periods we ran into */
+			w->missed++;
+			next = now_ns();
+			continue;
+		}
+		sleep_until(next);
+	}
+	return NULL;
+}
+
+/* Count the CPUs in a list such as "0-1,3" */
+static int online_cpus(void)
+{
+	char buf[128], *p = buf;
+	FILE *f;
+	int n = 0;
+
+	f = fopen(ONLINE_FILE, "r");
+	if (!f)
+		return -1;
+	if (!fgets(buf, sizeof(buf), f))
+		buf[0] = '\0';
+	fclose(f);
+
+	while (*p && *p != '\n') {
+		char *end;
+		long first = strtol(p, &end, 10), last = first;
+
+		if (end == p)
+			break;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+		n += last - first + 1;
+		p = *end == ',' ? end + 1 : end;
+	}
+	return n;
+}
+
+/* Account the ramp in progress, if any.  Called with ramp_lock held. */
+static void end_ramp(unsigned long long t)
+{
+	unsigned long long lat;
+
+	if (!want_since)
+		return;
+	lat = t - want_since;
+	ramp_ns += lat;
+	if (lat > ramp_max_ns)
+		ramp_max_ns = lat;
+	ramps++;
+	want_since = 0;
+}
+
+static void *sampler(void *data)
+{
+	unsigned long long last = now_ns();
+
+	(void)data;
+	while (sampling) {
+		unsigned long long t;
+		int online;
+
+		usleep(SAMPLE_US);
+		online = online_cpus();
+		t = now_ns();
+		online_ns += online * (t - last);
+		last = t;
+
+		pthread_mutex_lock(&ramp_lock);
+		if (online >= want_cpus)
+			end_ramp(t);
+		pthread_mutex_unlock(&ramp_lock);
+	}
+	return NULL;
+}
+
+/* Busy time of all CPUs in clock ticks, from /proc/stat */
+static unsigned long long busy_ticks(void)
+{
+	unsigned long long v[8] = { 0 };
+	char line[256];
+	FILE *f;
+
+	f = fopen("/proc/stat", "r");
+	if (!f) {
+		perror("/proc/stat");
+		exit(1);
+	}
+	if (!fgets(line, sizeof(line), f) ||
+	    sscanf(line, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &v[0], &v[1], &v[2], &v[3],
+		   &v[4], &v[5], &v[6], &v[7]) < 4) {
+		fprintf(stderr, "/proc/stat: unexpected format\n");
+		exit(1);
+	}
+	fclose(f);
+	/* user nice system idle iowait irq softirq steal */
+	return v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+}
+
+static int read_governor(char *buf, size_t len)
+{
+	FILE *f = fopen(GOVERNOR_FILE, "r");
+
+	if (!f || !fgets(buf, len, f)) {
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	fclose(f);
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+static int set_governor(const char *gov)
+{
+	FILE *f = fopen(GOVERNOR_FILE, "w");
+
+	if (!f)
+		return -1;
+	fprintf(f, "%s\n", gov);
+	return fclose(f);
+}
+
+static void load_script(struct script *s, const char *path)
+{
+	char line[256];
+	FILE *f;
+	int lineno = 0;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	s->name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	s->nr_phases = 0;
+	while (fgets(line, sizeof(line), f)) {
+		struct phase *p = &s->phase[s->nr_phases];
+		int n;
+
+		lineno++;
+		if (line[strspn(line, " \t")] == '#' ||
+		    line[strspn(line, " \t\n")] == '\0')
+			continue;
+		if (s->nr_phases == MAX_PHASES) {
+			fprintf(stderr, "%s: too many phases\n", path);
+			exit(1);
+		}
+		p->period_ms = 16;
+		n = sscanf(line, "%d %d %d %d", &p->ms, &p->threads, &p->duty,
+			   &p->period_ms);
+		if (n < 3 || p->ms < 1 || p->threads < 0 ||
+		    p->threads > MAX_THREADS || p->duty < 1 || p->duty > 100 ||
+		    p->period_ms < 1) {
+			fprintf(stderr, "%s:%d: bad phase\n", path, lineno);
+			exit(1);
+		}
+		s->nr_phases++;
+	}
+	fclose(f);
+}
+
+static void run(const char *gov, const struct script *s, int nr_cpus)
+{
+	struct worker w[MAX_THREADS];
+	pthread_t sampler_thread;
+	unsigned long long start, busy, elapsed;
+	unsigned long bursts = 0, missed = 0;
+	double busy_s, online_s, energy;
+	int i, j;
+
+	online_ns = ramp_ns = ramp_max_ns = 0;
+	ramps = 0;
+	want_since = 0;
+	sampling = 1;
+	pthread_create(&sampler_thread, NULL, sampler, NULL);
+
+	busy = busy_ticks();
+	start = now_ns();
+	for (i = 0; i < s->nr_phases; i++) {
+		const struct phase *p = &s->phase[i];
+		int want = p->threads < nr_cpus ? p->threads : nr_cpus;
+
+		pthread_mutex_lock(&ramp_lock);
+		if (online_cpus() < want) {
+			want_cpus = want;
+			want_since = now_ns();
+		}
+		pthread_mutex_unlock(&ramp_lock);
+
+		stop = 0;
+		for (j = 0; j < p->threads; j++) {
+			memset(&w[j], 0, sizeof(w[j]));
+			w[j].phase = p;
+			pthread_create(&w[j].thread, NULL, burst, &w[j]);
+		}
+		usleep(p->ms * 1000);
+		stop = 1;
+		for (j = 0; j < p->threads; j++) {
+			pthread_join(w[j].thread, NULL);
+			bursts += w[j].bursts;
+			missed += w[j].missed;
+		}
+		/* a ramp the phase did not see the end of counts in full */
+		pthread_mutex_lock(&ramp_lock);
+		end_ramp(now_ns());
+		pthread_mutex_unlock(&ramp_lock);
+	}
+	elapsed = now_ns() - start;
+	busy = busy_ticks() - busy;
+
+	sampling = 0;
+	pthread_join(sampler_thread, NULL);
+
+	busy_s = busy / (double)sysconf(_SC_CLK_TCK);
+	online_s = online_ns / 1e9;
+	energy = busy_s * active_mw;
+	if (online_s > busy_s)
+		energy += (online_s - busy_s) * idle_mw;
+
+	printf("%-18s %-16s %6.2f %8.1f %8.1f %6lu/%-7lu %9.0f\n",
+	       gov, s->name, online_ns / (double)elapsed,
+	       ramps ? ramp_ns / 1e6 / ramps : 0.0, ramp_max_ns / 1e6,
+	       missed, bursts, energy);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	char *governors = NULL, *gov, *save;
+	char orig[64];
+	struct script *scripts;
+	int nr_scripts, nr_cpus;
+	int opt, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "g:s:a:i:")) != -1) {
+		switch (opt) {
+		case 'g':
+			governors = optarg;
+			break;
+		case 's':
+			settle_ms = atoi(optarg);
+			break;
+		case 'a':
+			active_mw = atoi(optarg);
+			break;
+		case 'i':
+			idle_mw = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind == argc)
+		goto usage;
+
+	if (read_governor(orig, sizeof(orig))) {
+		perror(GOVERNOR_FILE);
+		return 1;
+	}
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+
+	nr_scripts = argc - optind;
+	scripts = calloc(nr_scripts, sizeof(*scripts));
+	if (!scripts)
+		return 1;
+	for (i = 0; i < nr_scripts; i++)
+		load_script(&scripts[i], argv[optind + i]);
+
+	governors = strdup(governors ? governors : default_governors);
+	printf("%-18s %-16s %6s %8s %8s %14s %9s\n", "governor", "workload",
+	       "cpus", "ramp ms", "max ms", "missed/bursts", "energy mJ");
+	for (gov = strtok_r(governors, ",", &save); gov;
+	     gov = strtok_r(NULL, ",", &save)) {
+		if (set_governor(gov)) {
+			fprintf(stderr, "%s: cannot select %s: %s\n",
+				GOVERNOR_FILE, gov, strerror(errno));
+			ret = 1;
+			continue;
+		}
+		for (i = 0; i < nr_scripts; i++) {
+			/* let the governor settle from the previous run */
+			usleep(settle_ms * 1000);
+			run(gov, &scripts[i], nr_cpus);
+		}
+	}
+
+	set_governor(orig);
+	free(governors);
+	free(scripts);
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s [-g gov,gov,...] [-s settle_ms] "
+		"[-a active_mW] [-i idle_mW] script...\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,314 @@
+/*
+ * fuse-bench: measure FUSE request throughput with a minimal daemon
+ *
+ * Mounts a filesystem containing a single empty file, served by a tiny
+ * in-process daemon that speaks the /dev/fuse protocol directly, with
+ * all caching disabled so every stat() goes to the daemon.  Then runs
+ * one stat() loop per CPU and reports the aggregate operations per
+ * second.
+ *
+ * With -q each daemon thread clones the device fd, pins itself to a CPU
+ * and binds its fd to that CPU's request queue, so requests are read
+ * and answered on the CPU that issued them.  Without it all threads
+ * share the mount-time fd and its single pending list.
+ *
+ * Must be run as root.
+ *
+ * Usage: fuse-bench [-q] [-j threads] [-t seconds] [-m mountpoint]
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <linux/fuse.h>
+
+#ifndef FUSE_DEV_IOC_CLONE
+#define FUSE_DEV_IOC_CLONE	_IOR(229, 0, __u32)
+#endif
+#ifndef FUSE_DEV_IOC_BIND_QUEUE
+#define FUSE_DEV_IOC_BIND_QUEUE	_IOW(229, 1, __u32)
+#endif
+
+#define FILE_NODEID	2
+#define FILE_NAME	"file"
+/* Large enough for any request with the default max_write */
+#define BUF_SIZE	(132 * 1024)
+/* fuse_init_out up to and including max_write */
+#define INIT_OUT_SIZE	24
+
+static int dev_fd;
+static int per_cpu;
+static int nr_cpus;
+static volatile int stop;
+static char file_path[256];
+
+struct client {
+	pthread_t thread;
+	int cpu;
+	unsigned long ops;
+};
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void fill_attr(struct fuse_attr *attr, __u64 nodeid)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = nodeid;
+	if (nodeid == FUSE_ROOT_ID) {
+		attr->mode = S_IFDIR | 0755;
+		attr->nlink = 2;
+	} else {
+		attr->mode = S_IFREG | 0644;
+		attr->nlink = 1;
+	}
+}
+
+static void reply(int fd, struct fuse_in_header *in, int error,
+		  const void *arg, size_t argsize)
+{
+	char buf[sizeof(struct fuse_out_header) + 256];
+	struct fuse_out_header *out = (struct fuse_out_header *)buf;
+
+	out->unique = in->unique;
+	out->error = error;
+	out->len = sizeof(*out);
+	if (!error && argsize) {
+		memcpy(buf + sizeof(*out), arg, argsize);
+		out->len += argsize;
+	}
+	if (write(fd, buf, out->len) < 0 && errno != ENOENT)
+		perror("reply");
+}
+
+static void handle(int fd, char *buf)
+{
+	struct fuse_in_header *in = (struct fuse_in_header *)buf;
+	void *arg = buf + sizeof(*in);
+
+	switch (in->opcode) {
+	case FUSE_INIT: {
+		struct fuse_init_in *init_in = arg;
+		struct fuse_init_out init_out;
+
+		memset(&init_out, 0, sizeof(init_out));
+		init_out.major = FUSE_KERNEL_VERSION;
+		init_out.minor = init_in->minor;
+		init_out.max_write = 4096;
+		reply(fd, in, 0, &init_out, INIT_OUT_SIZE);
+		break;
+	}
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out entry;
+
+		if (in->nodeid != FUSE_ROOT_ID || strcmp(arg, FILE_NAME)) {
+			reply(fd, in, -ENOENT, NULL, 0);
+			break;
+		}
+		memset(&entry, 0, sizeof(entry));
+		entry.nodeid = FILE_NODEID;
+		fill_attr(&entry.attr, FILE_NODEID);
+		reply(fd, in, 0, &entry, sizeof(entry));
+		break;
+	}
+	case FUSE_GETATTR: {
+		struct fuse_attr_out attr;
+
+		memset(&attr, 0, sizeof(attr));
+		fill_attr(&attr.attr, in->nodeid);
+		reply(fd, in, 0, &attr, sizeof(attr));
+		break;
+	}
+	case FUSE_FORGET:
+	case FUSE_BATCH_FORGET:
+		break;
+	case FUSE_DESTROY:
+		reply(fd, in, 0, NULL, 0);
+		break;
+	default:
+		reply(fd, in, -ENOSYS, NULL, 0);
+		break;
+	}
+}
+
+static void *server(void *data)
+{
+	int id = (long)data;
+	int fd = dev_fd;
+	char *buf;
+	ssize_t res;
+
+	buf = malloc(BUF_SIZE);
+	if (!buf)
+		return NULL;
+
+	if (per_cpu) {
+		__u32 cpu = id % nr_cpus;
+		__u32 master = dev_fd;
+
+		pin(cpu);
+		if (id) {
+			fd = open("/dev/fuse", O_RDWR);
+			if (fd < 0 || ioctl(fd, FUSE_DEV_IOC_CLONE, &master)) {
+				perror("FUSE_DEV_IOC_CLONE");
+				exit(1);
+			}
+		}
+		if (ioctl(fd, FUSE_DEV_IOC_BIND_QUEUE, &cpu)) {
+			perror("FUSE_DEV_IOC_BIND_QUEUE");
+			exit(1);
+		}
+	}
+
+	for (;;) {
+		res = read(fd, buf, BUF_SIZE);
+		if (res < 0) {
+			if (errno == EINTR || errno == ENOENT || errno == EAGAIN)
+				continue;
+			/* ENODEV once the filesystem is unmounted */
+			break;
+		}
+		handle(fd, buf);
+	}
+
+	if (fd != dev_fd)
+		close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void *client(void *data)
+{
+	struct client *c = data;
+	struct stat st;
+
+	pin(c->cpu);
+	while (!stop) {
+		if (stat(file_path, &st)) {
+			perror(file_path);
+			exit(1);
+		}
+		c->ops++;
+	}
+	return NULL;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	char tmpl[] = "/tmp/fuse-bench.XXXXXX";
+	char *mnt = NULL;
+	char opts[128];
+	struct client *clients;
+	pthread_t *servers;
+	unsigned long total = 0;
+	int threads, seconds = 5;
+	int opt, i;
+	double start, elapsed;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	threads = nr_cpus;
+
+	while ((opt = getopt(argc, argv, "qj:t:m:")) != -1) {
+		switch (opt) {
+		case 'q':
+			per_cpu = 1;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'm':
+			mnt = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-q] [-j threads] "
+				"[-t seconds] [-m mountpoint]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (threads < 1)
+		threads = 1;
+
+	if (!mnt) {
+		mnt = mkdtemp(tmpl);
+		if (!mnt) {
+			perror("mkdtemp");
+			return 1;
+		}
+	}
+	snprintf(file_path, sizeof(file_path), "%s/" FILE_NAME, mnt);
+
+	dev_fd = open("/dev/fuse", O_RDWR);
+	if (dev_fd < 0) {
+		perror("/dev/fuse");
+		return 1;
+	}
+	snprintf(opts, sizeof(opts), "fd=%d,rootmode=40000,user_id=%d,"
+		 "group_id=%d", dev_fd, getuid(), getgid());
+	if (mount("fuse-bench", mnt, "fuse", MS_NOSUID | MS_NODEV, opts)) {
+		perror("mount");
+		return 1;
+	}
+
+	servers = calloc(threads, sizeof(*servers));
+	clients = calloc(threads, sizeof(*clients));
+	if (!servers || !clients)
+		return 1;
+
+	for (i = 0; i < threads; i++)
+		pthread_create(&servers[i], NULL, server, (void *)(long)i);
+
+	start = now();
+	for (i = 0; i < threads; i++) {
+		clients[i].cpu = i % nr_cpus;
+		pthread_create(&clients[i].thread, NULL, client, &clients[i]);
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < threads; i++) {
+		pthread_join(clients[i].thread, NULL);
+		total += clients[i].ops;
+	}
+	elapsed = now() - start;
+
+	umount2(mnt, MNT_DETACH);
+	for (i = 0; i < threads; i++)
+		pthread_join(servers[i], NULL);
+	close(dev_fd);
+	if (mnt == tmpl)
+		rmdir(mnt);
+
+	printf("%s queues, %d threads: %.0f stat/s\n",
+	       per_cpu ? "per-cpu" : "shared", threads, total / elapsed);
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * pack-bench: compare small task packing against spreading
+ *
+ * Runs a mix of light periodic threads (a short burst of work every
+ * period) and optional CPU bound threads, once with
+ * /proc/sys/kernel/sched_packing off and once with it on, and reports
+ * for each run:
+ *
+ *  - the busy time of every CPU, from /proc/stat
+ *  - a modelled energy: busy time at the active power, plus idle time at
+ *    the idle power for the CPUs that were used at all.  A CPU that was
+ *    never used could have been power gated or taken offline by cpuquiet
+ *    and costs nothing.
+ *  - the throughput of the CPU bound threads, and how many light bursts
+ *    missed the end of their period.
+ *
+ * The model is crude, but it is what packing trades on, and it works the
+ * same in QEMU (see pack-qemu.sh) as on hardware.  When run as init (pid
+ * 1) it mounts /proc itself and powers off at the end.
+ *
+ * Must be run as root.
+ *
+ * Usage: pack-bench [-l light] [-H heavy] [-d duty%] [-p period_ms]
+ *                   [-t seconds] [-a active_mW] [-i idle_mW]
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/reboot.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PACKING_SYSCTL	"/proc/sys/kernel/sched_packing"
+#define MAX_CPUS	32
+/* a CPU busy for less than this share of the run counts as unused */
+#define USED_PERMILLE	10
+
+static int nr_cpus;
+static int nr_light = 4, nr_heavy;
+static int duty = 10, period_ms = 16, seconds = 10;
+static int active_mw = 1000, idle_mw = 100;
+static volatile int stop;
+
+struct worker {
+	pthread_t thread;
+	unsigned long long work;	/* spin loops done */
+	unsigned long bursts, missed;
+};
+
+struct cpu_times {
+	unsigned long long busy, total;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void spin_until(struct worker *w, unsigned long long end)
+{
+	while (now_ns() < end)
+		w->work++;
+}
+
+static void *light(void *data)
+{
+	struct worker *w = data;
+	unsigned long long period = period_ms * 1000000ULL;
+	unsigned long long next = now_ns();
+	struct timespec ts;
+
+	while (!stop) {
+		spin_until(w, now_ns() + period * duty / 100);
+		w->bursts++;
+
+		next += period;
+		if (now_ns() > next) {
+			/* skip the periods we ran into */
+			w->missed++;
+			next = now_ns();
+			continue;
+		}
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+	return NULL;
+}
+
+static void *heavy(void *data)
+{
+	struct worker *w = data;
+
+	while (!stop)
+		w->work++;
+	return NULL;
+}
+
+static int read_cpu_times(struct cpu_times *t)
+{
+	char line[256];
+	FILE *f;
+	int n = 0;
+
+	f = fopen("/proc/stat", "r");
+	if (!f) {
+		perror("/proc/stat");
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f) && n < MAX_CPUS) {
+		unsigned long long v[8] = { 0 };
+		int cpu;
+
+		if (strncmp(line, "cpu", 3) || line[3] == ' ')
+			continue;
+		if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu",
+			   &cpu, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+			   &v[6], &v[7]) < 5)
+			continue;
+		/* user nice system idle iowait irq softirq steal */
+		t[cpu].busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+		t[cpu].total = t[cpu].busy + v[3] + v[4];
+		n = cpu + 1;
+	}
+	fclose(f);
+	return n;
+}
+
+static int set_packing(int on)
+{
+	FILE *f = fopen(PACKING_SYSCTL, "w");
+
+	if (!f)
+		return -1;
+	fprintf(f, "%d\n", on);
+	return fclose(f);
+}
+
+static void run(int packing)
+{
+	struct cpu_times before[MAX_CPUS], after[MAX_CPUS];
+	struct worker *w;
+	unsigned long long work = 0;
+	unsigned long bursts = 0, missed = 0;
+	double energy = 0, elapsed;
+	int nr = nr_light + nr_heavy;
+	int used = 0;
+	int i, n;
+
+	if (set_packing(packing)) {
+		perror(PACKING_SYSCTL);
+		exit(1);
+	}
+	/* let the averages settle from the previous run */
+	sleep(1);
+
+	w = calloc(nr, sizeof(*w));
+	if (!w)
+		exit(1);
+
+	stop = 0;
+	read_cpu_times(before);
+	for (i = 0; i < nr; i++)
+		pthread_create(&w[i].thread, NULL, i < nr_light ? light : heavy,
+			       &w[i]);
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nr; i++) {
+		pthread_join(w[i].thread, NULL);
+		if (i < nr_light) {
+			bursts += w[i].bursts;
+			missed += w[i].missed;
+		} else {
+			work += w[i].work;
+		}
+	}
+	n = read_cpu_times(after);
+
+	printf("packing %s:\n", packing ? "on" : "off");
+	for (i = 0; i < n; i++) {
+		unsigned long long busy = after[i].busy - before[i].busy;
+		unsigned long long total = after[i].total - before[i].total;
+		int permille = total ? busy * 1000 / total : 0;
+
+		elapsed = total / (double)sysconf(_SC_CLK_TCK);
+		printf("  cpu%d: %3d.%d%% busy\n", i, permille / 10,
+		       permille % 10);
+		energy += elapsed * permille / 1000 * active_mw;
+		if (permille >= USED_PERMILLE) {
+			energy += elapsed * (1000 - permille) / 1000 * idle_mw;
+			used++;
+		}
+	}
+	printf("  cpus used: %d of %d\n", used, n);
+	printf("  energy: %.0f mJ\n", energy);
+	printf("  light bursts: %lu, missed periods: %lu\n", bursts, missed);
+	if (nr_heavy)
+		printf("  heavy work: %.0f loops/s\n", (double)work / seconds);
+
+	free(w);
+}
+
+int main(int argc, char **argv)
+{
+	int init = getpid() == 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:H:d:p:t:a:i:")) != -1) {
+		switch (opt) {
+		case 'l':
+			nr_light = atoi(optarg);
+			break;
+		case 'H':
+			nr_heavy = atoi(optarg);
+			break;
+		case 'd':
+			duty = atoi(optarg);
+			break;
+		case 'p':
+			period_ms = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'a':
+			active_mw = atoi(optarg);
+			break;
+		case 'i':
+			idle_mw = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-l light] [-H heavy] "
+				"[-d duty%%] [-p period_ms] [-t seconds] "
+				"[-a active_mW] [-i idle_mW]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (duty < 1 || duty > 100 || period_ms < 1 || seconds < 1) {
+		fprintf(stderr, "bad duty, period or duration\n");
+		return 1;
+	}
+
+	if (init && mount("proc", "/proc", "proc", 0, NULL) && errno != EBUSY) {
+		perror("mount /proc");
+		return 1;
+	}
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	printf("%d cpus, %d light threads (%d%% of %d ms), %d heavy, %d s\n",
+	       nr_cpus, nr_light, duty, period_ms, nr_heavy, seconds);
+
+	run(0);
+	run(1);
+
+	if (init) {
+		sync();
+		reboot(RB_POWER_OFF);
+	}
+	return 0;
+}
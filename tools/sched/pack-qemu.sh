@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Boot an ARM kernel in QEMU with pack-bench as init, and print its
+# comparison of small task packing against spreading.
+#
+# The kernel needs CONFIG_SMP, CONFIG_ARM_CPU_TOPOLOGY, CONFIG_BLK_DEV_INITRD
+# and support for the emulated machine (vexpress-a9 by default).  Options
+# after the kernel image are passed on to pack-bench.
+#
+# Usage: pack-qemu.sh zImage [pack-bench options]
+#
+# Environment: CROSS_COMPILE (arm-linux-gnueabi-), QEMU (qemu-system-arm),
+#              MACHINE (vexpress-a9), SMP (4)
+#
+# Licensed under the terms of the GNU GPL License version 2
+
+set -e
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 zImage [pack-bench options]" >&2
+	exit 1
+fi
+
+KERNEL=$1
+shift
+
+CROSS_COMPILE=${CROSS_COMPILE-arm-linux-gnueabi-}
+QEMU=${QEMU:-qemu-system-arm}
+MACHINE=${MACHINE:-vexpress-a9}
+SMP=${SMP:-4}
+
+SRC=$(dirname "$0")
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+mkdir "$DIR/root" "$DIR/root/proc"
+${CROSS_COMPILE}gcc -Wall -O2 -static -o "$DIR/root/init" \
+	"$SRC/pack-bench.c" -lpthread
+(cd "$DIR/root" && printf 'init\nproc\n' | cpio -o -H newc --quiet) | \
+	gzip > "$DIR/initramfs.gz"
+
+# Unknown options without '=' on the command line end up in init's argv
+$QEMU -M "$MACHINE" -smp "$SMP" -m 256 -nographic -no-reboot \
+	-kernel "$KERNEL" -initrd "$DIR/initramfs.gz" \
+	-append "console=ttyAMA0 quiet rdinit=/init $*"
@@ -0,0 +1,130 @@
+/*
+ * zram-bench: measure zram write throughput versus number of writers
+ *
+ * Forks 1..N writer processes that each write compressible pages to a
+ * disjoint region of a zram device with O_DIRECT, and reports the
+ * aggregate throughput for each writer count. Use together with the
+ * max_comp_streams sysfs attribute to see how compression scales.
+ *
+ * Usage: zram-bench [-d /dev/zram0] [-j max_writers] [-s MiB per writer]
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PAGE_SZ		4096
+#define BATCH_PAGES	16
+
+static const char *dev = "/dev/zram0";
+
+/* Half random, half zero: roughly a 2:1 compression ratio */
+static void fill_page(unsigned char *p, unsigned int seed)
+{
+	int i;
+
+	for (i = 0; i < PAGE_SZ / 2; i++) {
+		seed = seed * 1103515245 + 12345;
+		p[i] = seed >> 16;
+	}
+	memset(p + PAGE_SZ / 2, 0, PAGE_SZ / 2);
+}
+
+static int writer(int id, unsigned long pages)
+{
+	unsigned char *buf;
+	unsigned long done;
+	off_t off = (off_t)id * pages * PAGE_SZ;
+	int fd, i;
+
+	fd = open(dev, O_WRONLY | O_DIRECT);
+	if (fd < 0) {
+		perror(dev);
+		return 1;
+	}
+	if (posix_memalign((void **)&buf, PAGE_SZ, BATCH_PAGES * PAGE_SZ))
+		return 1;
+
+	for (done = 0; done < pages; done += BATCH_PAGES) {
+		for (i = 0; i < BATCH_PAGES; i++)
+			fill_page(buf + i * PAGE_SZ, done + i + id);
+		if (pwrite(fd, buf, BATCH_PAGES * PAGE_SZ,
+			   off + done * PAGE_SZ) < 0) {
+			perror("pwrite");
+			return 1;
+		}
+	}
+
+	free(buf);
+	close(fd);
+	return 0;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long pages = (64UL << 20) / PAGE_SZ;
+	int max_writers = sysconf(_SC_NPROCESSORS_ONLN);
+	int opt, n, i, status, err;
+	double start, elapsed;
+
+	while ((opt = getopt(argc, argv, "d:j:s:")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'j':
+			max_writers = atoi(optarg);
+			break;
+		case 's':
+			pages = strtoul(optarg, NULL, 0) * (1UL << 20) / PAGE_SZ;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d dev] [-j max_writers] "
+				"[-s MiB per writer]\n", argv[0]);
+			return 1;
+		}
+	}
+	pages -= pages % BATCH_PAGES;
+
+	printf("%8s %12s\n", "writers", "MiB/s");
+	for (n = 1; n <= max_writers; n++) {
+		err = 0;
+		start = now();
+		for (i = 0; i < n; i++) {
+			if (fork() == 0)
+				exit(writer(i, pages));
+		}
+		for (i = 0; i < n; i++) {
+			wait(&status);
+			if (!WIFEXITED(status) || WEXITSTATUS(status))
+				err = 1;
+		}
+		elapsed = now() - start;
+		if (err) {
+			fprintf(stderr, "writer failed, is %s large enough?\n",
+				dev);
+			return 1;
+		}
+		printf("%8d %12.1f\n", n,
+		       (double)n * pages * PAGE_SZ / (1 << 20) / elapsed);
+	}
+
+	return 0;
+}